@@ -44,11 +44,24 @@
 
 using namespace ManaServ;
 
+/**
+ * Percentiles of a duration, in microseconds.
+ */
+struct TickStatistics
+{
+  TickStatistics(): p50(0), p95(0), p99(0) {}
+
+  unsigned p50;
+  unsigned p95;
+  unsigned p99;
+};
+
 struct MapStatistics
 {
   std::vector<int> players;
   unsigned short nbEntities;
   unsigned short nbMonsters;
+  TickStatistics tickTime;
 };
 
 typedef std::map<unsigned short, MapStatistics> ServerStatistics;
@@ -64,6 +77,7 @@ struct GameServer: NetComputer
     std::string address;
     NetComputer *server;
     ServerStatistics maps;
+    std::vector<TickStatistics> tickPhases;
     short port;
 };
 
@@ -452,6 +466,37 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
             }
         } break;
 
+        case GAMSG_TICK_STATISTICS:
+        {
+            int nbPhases = msg.readInt8();
+            server->tickPhases.resize(nbPhases);
+            for (int j = 0; j < nbPhases; ++j)
+            {
+                TickStatistics &t = server->tickPhases[j];
+                t.p50 = msg.readInt32();
+                t.p95 = msg.readInt32();
+                t.p99 = msg.readInt32();
+            }
+
+            while (msg.getUnreadLength())
+            {
+                int mapId = msg.readInt16();
+                ServerStatistics::iterator i = server->maps.find(mapId);
+                if (i == server->maps.end())
+                {
+                    LOG_ERROR("Server " << server->address << ':'
+                              << server->port << " should not be sending tick"
+                              " statistics for map " << mapId << '.');
+                    // Skip remaining data.
+                    break;
+                }
+                TickStatistics &t = i->second.tickTime;
+                t.p50 = msg.readInt32();
+                t.p95 = msg.readInt32();
+                t.p99 = msg.readInt32();
+            }
+        } break;
+
         case GCMSG_REQUEST_POST:
         {
             // Retrieve the post for user
@@ -627,12 +672,23 @@ void GameServerHandler::dumpStatistics(std::ostream &os)
         os << "<gameserver address=\"" << server->address << "\" port=\""
            << server->port << "\">\n";
 
+        for (unsigned j = 0; j < server->tickPhases.size(); ++j)
+        {
+            const TickStatistics &t = server->tickPhases[j];
+            os << "<tick_phase name=\"" << getTickPhaseName(j)
+               << "\" p50=\"" << t.p50 << "\" p95=\"" << t.p95
+               << "\" p99=\"" << t.p99 << "\"/>\n";
+        }
+
         for (ServerStatistics::const_iterator j = server->maps.begin(),
              j_end = server->maps.end(); j != j_end; ++j)
         {
             const MapStatistics &m = j->second;
             os << "<map id=\"" << j->first << "\" nb_entities=\"" << m.nbEntities
-               << "\" nb_monsters=\"" << m.nbMonsters << "\">\n";
+               << "\" nb_monsters=\"" << m.nbMonsters
+               << "\" tick_p50=\"" << m.tickTime.p50
+               << "\" tick_p95=\"" << m.tickTime.p95
+               << "\" tick_p99=\"" << m.tickTime.p99 << "\">\n";
             for (std::vector< int >::const_iterator k = m.players.begin(),
                  k_end = m.players.end(); k != k_end; ++k)
             {
@@ -647,10 +647,12 @@ void ChatHandler::sendInChannel(ChatChannel *channel, MessageOut &msg)
 {
     const ChatChannel::ChannelUsers &users = channel->getUserList();
 
+    // All the users of the channel get the same packet
+    SharedPacket packet(msg);
     for (ChatChannel::ChannelUsers::const_iterator
          i = users.begin(), i_end = users.end(); i != i_end; ++i)
     {
-        (*i)->send(msg);
+        (*i)->send(packet);
     }
 }
 
@@ -220,7 +220,7 @@ class ChatHandler : public ConnectionHandler
          * Sends a message to every client in a registered channel.
          *
          * @param channel the channel to send the message in, must not be nullptr
-         * @param msg     the message to be sent
+         * @param msg     the message to be sent, left empty
          */
         void sendInChannel(ChatChannel *channel, MessageOut &msg);
 
@@ -19,9 +19,11 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <map>
 #include <set>
+#include <vector>
 #include <libxml/xmlreader.h>
 
 #include "common/configuration.h"
@@ -37,6 +39,40 @@ static std::map< std::string, std::string > options;
 /**< Location of config file. */
 static std::string configPath;
 static std::set<std::string> processedFiles;
+/**< Whether initialize() was called. */
+static bool initialized = false;
+
+typedef std::vector< Configuration::OptionHandle * > OptionHandles;
+
+/**
+ * Gets the registered option handles. Function-local so that it exists before
+ * the first static handle is constructed.
+ */
+static OptionHandles &getOptionHandles()
+{
+    static OptionHandles handles;
+    return handles;
+}
+
+/**
+ * Updates the values of the option handles and notifies about the changed
+ * ones.
+ */
+static void updateOptionHandles(bool notify)
+{
+    // Copied since the listeners may create or destroy handles.
+    const OptionHandles handles = getOptionHandles();
+    for (OptionHandles::const_iterator it = handles.begin(),
+         it_end = handles.end(); it != it_end; ++it)
+    {
+        if ((*it)->update() && notify)
+        {
+            LOG_INFO("Configuration option " << (*it)->getKey()
+                     << " changed.");
+            (*it)->signal_changed.emit();
+        }
+    }
+}
 
 static bool readFile(const std::string &fileName)
 {
@@ -95,14 +131,41 @@ bool Configuration::initialize(const std::string &fileName)
 
     LOG_INFO("Using config file: " << configPath);
 
+    initialized = true;
+    updateOptionHandles(false);
+
     return success;
 }
 
+bool Configuration::reload()
+{
+    std::map< std::string, std::string > previousOptions;
+    previousOptions.swap(options);
+    processedFiles.clear();
+
+    if (!readFile(configPath))
+    {
+        LOG_WARN("Keeping the previous configuration.");
+        options.swap(previousOptions);
+        return false;
+    }
+
+    LOG_INFO("Reloaded config file: " << configPath);
+
+    updateOptionHandles(true);
+    return true;
+}
+
 void Configuration::deinitialize()
 {
     processedFiles.clear();
 }
 
+bool Configuration::isInitialized()
+{
+    return initialized;
+}
+
 std::string Configuration::getValue(const std::string &key,
                                     const std::string &deflt)
 {
@@ -127,3 +190,18 @@ bool Configuration::getBoolValue(const std::string &key, bool deflt)
         return deflt;
     return utils::stringToBool(iter->second.c_str(), deflt);
 }
+
+Configuration::OptionHandle::OptionHandle(const std::string &key):
+    mKey(key)
+{
+    getOptionHandles().push_back(this);
+}
+
+Configuration::OptionHandle::~OptionHandle()
+{
+    OptionHandles &handles = getOptionHandles();
+    OptionHandles::iterator it =
+            std::find(handles.begin(), handles.end(), this);
+    if (it != handles.end())
+        handles.erase(it);
+}
@@ -24,6 +24,8 @@
 
 #include <string>
 
+#include <sigc++/signal.h>
+
 namespace Configuration
 {
     /**
@@ -37,6 +39,11 @@ namespace Configuration
 
     void deinitialize();
 
+    /**
+     * Whether the configuration was loaded, after which options can be read.
+     */
+    bool isInitialized();
+
     /**
      * Gets an option as a string.
      * @param key option identifier.
@@ -57,6 +64,99 @@ namespace Configuration
      * @param deflt default value.
      */
     bool getBoolValue(const std::string &key, bool deflt);
+
+    /**
+     * Reads the configuration file again and updates the option handles.
+     * The previous options are kept when the file can't be read.
+     *
+     * @return whether the configuration file could be read
+     */
+    bool reload();
+
+    /**
+     * Handle on an option, keeping its parsed value so that options used on
+     * every tick don't need to be looked up. The value is updated when the
+     * configuration is loaded or reloaded.
+     *
+     * Handles are usually static objects. They may be created before the
+     * configuration is loaded, in which case they hold the default value
+     * until then.
+     */
+    class OptionHandle
+    {
+        public:
+            OptionHandle(const std::string &key);
+
+            virtual ~OptionHandle();
+
+            const std::string &getKey() const
+            { return mKey; }
+
+            /**
+             * Reads the value of the option again.
+             * @return whether the value changed.
+             */
+            virtual bool update() = 0;
+
+            /**
+             * Emitted when the value changed after a reload.
+             */
+            sigc::signal<void> signal_changed;
+
+        private:
+            OptionHandle(const OptionHandle &);
+            OptionHandle &operator=(const OptionHandle &);
+
+            std::string mKey;
+    };
+
+    inline void readValue(const std::string &key, int deflt, int &value)
+    { value = getValue(key, deflt); }
+
+    inline void readValue(const std::string &key, bool deflt, bool &value)
+    { value = getBoolValue(key, deflt); }
+
+    inline void readValue(const std::string &key, const std::string &deflt,
+                          std::string &value)
+    { value = getValue(key, deflt); }
+
+    template< typename T >
+    class Option : public OptionHandle
+    {
+        public:
+            Option(const std::string &key, const T &deflt):
+                OptionHandle(key),
+                mDefault(deflt),
+                mValue(deflt)
+            {
+                if (isInitialized())
+                    update();
+            }
+
+            const T &get() const
+            { return mValue; }
+
+            operator const T &() const
+            { return mValue; }
+
+            bool update()
+            {
+                T value;
+                readValue(getKey(), mDefault, value);
+                if (value == mValue)
+                    return false;
+                mValue = value;
+                return true;
+            }
+
+        private:
+            T mDefault;
+            T mValue;
+    };
+
+    typedef Option< int > IntOption;
+    typedef Option< bool > BoolOption;
+    typedef Option< std::string > StringOption;
 }
 
 #ifndef DEFAULT_SERVER_PORT
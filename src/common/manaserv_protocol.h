@@ -29,8 +29,11 @@
 namespace ManaServ {
 
 enum {
-    PROTOCOL_VERSION = 10,
+    PROTOCOL_VERSION = 13,
     MIN_PROTOCOL_VERSION = 9,
+    MIN_BUNDLE_PROTOCOL_VERSION = 11,   // Clients able to read XXMSG_BUNDLE
+    MIN_COMPACT_PROTOCOL_VERSION = 12,  // Clients able to use compact messages
+    MIN_MOVEMENT_DELTA_PROTOCOL_VERSION = 13,   // Clients acknowledging moves
     SUPPORTED_DB_VERSION = 26
 };
 
@@ -46,6 +49,15 @@ enum ValueType {
     Double
 };
 
+/**
+ * In the compact encoding, which a game client and server agree on through
+ * GPMSG_CONNECT_RESPONSE, the W and D values of the messages following it are
+ * sent as zigzag varints: the value v becomes (v << 1) ^ (v >> 31), written
+ * 7 bits at a time from the lowest ones, with the high bit of each byte set
+ * when more follow. This includes the lengths of strings. Message IDs stay
+ * two bytes.
+ */
+
 /**
  * Enumerated type for communicated messages:
  *
@@ -95,8 +107,8 @@ enum {
     PAMSG_PASSWORD_CHANGE          = 0x0034, // S old password, S new password
     APMSG_PASSWORD_CHANGE_RESPONSE = 0x0035, // B error
 
-    PGMSG_CONNECT                  = 0x0050, // B*32 token
-    GPMSG_CONNECT_RESPONSE         = 0x0051, // B error
+    PGMSG_CONNECT                  = 0x0050, // B*32 token [, D version]
+    GPMSG_CONNECT_RESPONSE         = 0x0051, // B error [, B compact [, B deltas]]
     PCMSG_CONNECT                  = 0x0053, // B*32 token
     CPMSG_CONNECT_RESPONSE         = 0x0054, // B error
 
@@ -148,6 +160,8 @@ enum {
     GPMSG_BEING_ABILITY_POINT      = 0x0282, // W being id, B abilityId, W*2 point
     GPMSG_BEING_ABILITY_BEING      = 0x0283, // W being id, B abilityId, W target being id
     GPMSG_BEING_ABILITY_DIRECTION  = 0x0284, // W being id, B abilityId, B direction
+    GPMSG_BEINGS_MOVE_DELTA        = 0x0285, // W sequence, W base sequence, { W being id, B flags [, W*2 position] [, W*2 destination | B*2 destination change] [, B speed] }*
+    PGMSG_BEINGS_MOVE_ACK          = 0x0286, // W sequence
     PGMSG_USE_ABILITY_ON_BEING     = 0x0290, // B abilityID, W being id
     PGMSG_USE_ABILITY_ON_POINT     = 0x0291, // B abilityID, W*2 position
     PGMSG_USE_ABILITY_ON_DIRECTION = 0x0292, // B abilityID, B direction
@@ -281,6 +295,7 @@ enum {
     GAMSG_BAN_PLAYER            = 0x0550, // D id, W duration
     GAMSG_CHANGE_ACCOUNT_LEVEL  = 0x0556, // D id, W level
     GAMSG_STATISTICS            = 0x0560, // { W map id, W entity nb, W monster nb, W player nb, { D character id }* }*
+    GAMSG_TICK_STATISTICS       = 0x0561, // B phase nb, { D p50, D p95, D p99 }*, { W map id, D p50, D p95, D p99 }*
     CGMSG_CHANGED_PARTY         = 0x0590, // D character id, D party id
     GCMSG_REQUEST_POST          = 0x05A0, // D character id
     CGMSG_POST_RESPONSE         = 0x05A1, // D receiver id, { S sender name, S letter, W num attachments { W attachment item id, W quantity } }
@@ -291,6 +306,7 @@ enum {
     GAMSG_REMOVE_ITEM_ON_MAP    = 0x0602, // D map id, D item id, W amount, W pos x, W pos y
     GAMSG_ANNOUNCE              = 0x0603, // S text, W senderid, S sendername
 
+    XXMSG_BUNDLE                = 0x7FFE, // { W length, B* message }*, values never annotated in debug mode
     XXMSG_DEBUG_FLAG            = 0x8000, // Message in debug mode
     XXMSG_INVALID               = 0x7FFF
 };
@@ -333,6 +349,41 @@ enum {
     SYNC_ONLINE_STATUS       = 0x04        // D charId, B 0 = offline, 1 = online
 };
 
+// Phases of a game server tick, in the order used by GAMSG_TICK_STATISTICS. The
+// percentiles sent for each phase and map are in microseconds.
+enum TickPhase {
+    TICK_PHASE_TOTAL = 0,               // the whole tick
+    TICK_PHASE_ACCOUNT,                 // messages from the account server
+    TICK_PHASE_GAME,                    // messages from the clients
+    TICK_PHASE_SCRIPT,                  // script state update
+    TICK_PHASE_MAP_UPDATE,              // entities and movement, summed over the maps
+    TICK_PHASE_INFORM,                  // informing the players, summed over the maps
+    TICK_PHASE_DELAYED_EVENTS,          // delayed insertions, removals and warps
+    TICK_PHASE_FLUSH,                   // sending the messages to the clients
+    TICK_PHASE_PATHS,                   // starting the path searches on other threads
+    NB_TICK_PHASES
+};
+
+/**
+ * Helper function for getting the name of a tick phase
+ */
+inline const char *getTickPhaseName(int phase)
+{
+    switch (phase)
+    {
+        case TICK_PHASE_TOTAL:          return "tick";
+        case TICK_PHASE_ACCOUNT:        return "account";
+        case TICK_PHASE_GAME:           return "game";
+        case TICK_PHASE_SCRIPT:         return "script";
+        case TICK_PHASE_MAP_UPDATE:     return "map_update";
+        case TICK_PHASE_INFORM:         return "inform";
+        case TICK_PHASE_DELAYED_EVENTS: return "delayed_events";
+        case TICK_PHASE_FLUSH:          return "flush";
+        case TICK_PHASE_PATHS:          return "paths";
+        default:                        return "unknown";
+    }
+}
+
 // Login specific return values
 enum {
     LOGIN_INVALID_VERSION = 0x40,       // the user is using an incompatible protocol
@@ -392,7 +443,12 @@ enum {
     // Payload contains the current position.
     MOVING_POSITION = 1,
     // Payload contains the destination.
-    MOVING_DESTINATION = 2
+    MOVING_DESTINATION = 2,
+    // Payload contains the change of the destination since the base update,
+    // as signed bytes. Only in GPMSG_BEINGS_MOVE_DELTA.
+    MOVING_DESTINATION_CHANGE = 4,
+    // Payload contains the speed. Only in GPMSG_BEINGS_MOVE_DELTA.
+    MOVING_SPEED = 8
 };
 
 // Chat errors return values
@@ -27,6 +27,8 @@
 
 #include "utils/logger.h"
 
+#include <sigc++/adaptors/bind.h>
+
 AbilityComponent::AbilityComponent():
     mLastUsedAbilityId(0),
     mLastTargetBeingId(0)
@@ -35,23 +37,48 @@ AbilityComponent::AbilityComponent():
 
 void AbilityComponent::update(Entity &entity)
 {
-    // Update ability recharge
-    for (auto &it : mAbilities)
+    // Announce the abilities whose recharge timer fired. This is done here
+    // rather than from the timer, so that the script is only called while
+    // the entity is on a map.
+    if (mRechargedAbilities.empty())
+        return;
+
+    std::vector<int> recharged;
+    recharged.swap(mRechargedAbilities);
+
+    for (int id : recharged)
     {
-        auto &ability = it.second;
-        if (!ability.recharged && ability.rechargeTimeout.expired()) {
-            ability.recharged = true;
-
-            if (ability.abilityInfo->rechargedCallback.isValid()) {
-                Script *script = ScriptManager::currentState();
-                script->prepare(ability.abilityInfo->rechargedCallback);
-                script->push(&entity);
-                script->push(ability.abilityInfo->id);
-                script->execute(entity.getMap());
-            }
+        AbilityMap::iterator it = mAbilities.find(id);
+        if (it == mAbilities.end())
+            continue;
+
+        auto &ability = it->second;
+        if (ability.recharged || ability.rechargeTimer.isActive())
+            continue;
+
+        ability.recharged = true;
+
+        if (ability.abilityInfo->rechargedCallback.isValid()) {
+            Script *script = ScriptManager::currentState();
+            script->prepare(ability.abilityInfo->rechargedCallback);
+            script->push(&entity);
+            script->push(ability.abilityInfo->id);
+            script->execute(entity.getMap());
         }
     }
+}
 
+void AbilityComponent::startRecharge(AbilityValue &ability, int ticks)
+{
+    ability.recharged = false;
+    ability.rechargeTimer.start(ticks, sigc::bind(
+            sigc::mem_fun(this, &AbilityComponent::abilityRecharged),
+            ability.abilityInfo->id));
+}
+
+void AbilityComponent::abilityRecharged(int id)
+{
+    mRechargedAbilities.push_back(id);
 }
 
 /**
@@ -86,7 +113,7 @@ bool AbilityComponent::abilityUseCheck(AbilityMap::iterator it)
     {
         LOG_INFO("Character uses ability " << it->first
                  << " which is not recharged. ("
-                 << ability.rechargeTimeout.remaining()
+                 << ability.rechargeTimer.remaining()
                  << " ticks are missing)");
         return false;
     }
@@ -211,8 +238,11 @@ bool AbilityComponent::giveAbility(int id)
 
 bool AbilityComponent::giveAbility(const AbilityManager::AbilityInfo *info)
 {
-    bool added = mAbilities.insert(std::pair<int, AbilityValue>(info->id,
-                                   AbilityValue(info))).second;
+    auto inserted = mAbilities.insert(std::pair<int, AbilityValue>(info->id,
+                                      AbilityValue(info)));
+    bool added = inserted.second;
+    if (added)
+        startRecharge(inserted.first->second, 0);
 
     signal_ability_changed.emit(info->id);
     return added;
@@ -226,8 +256,7 @@ void AbilityComponent::setAbilityCooldown(int id, int ticks)
     AbilityMap::iterator it = mAbilities.find(id);
     if (it != mAbilities.end())
     {
-        it->second.recharged = false;
-        it->second.rechargeTimeout.set(ticks);
+        startRecharge(it->second, ticks);
         signal_ability_changed.emit(id);
     }
 }
@@ -236,7 +265,7 @@ int AbilityComponent::abilityCooldown(int id)
 {
     AbilityMap::iterator it = mAbilities.find(id);
     if (it != mAbilities.end() && !it->second.recharged)
-        return it->second.rechargeTimeout.remaining();
+        return it->second.rechargeTimer.remaining();
 
     return 0;
 }
@@ -24,11 +24,14 @@
 #include "game-server/abilitymanager.h"
 #include "game-server/component.h"
 #include "game-server/timeout.h"
+#include "game-server/timerwheel.h"
 
 #include "utils/point.h"
 
 #include <sigc++/signal.h>
 
+#include <vector>
+
 struct AbilityValue
 {
     AbilityValue(const AbilityManager::AbilityInfo *abilityInfo)
@@ -37,7 +40,7 @@ struct AbilityValue
     {}
 
     bool recharged;
-    Timeout rechargeTimeout;
+    Timer rechargeTimer;
     const AbilityManager::AbilityInfo *abilityInfo;
 };
 
@@ -47,7 +50,7 @@ struct AbilityValue
 typedef std::map<unsigned, AbilityValue> AbilityMap;
 
 
-class AbilityComponent: public Component
+class AbilityComponent : public PooledComponent<AbilityComponent>
 {
 public:
     static const ComponentType type = CT_Ability;
@@ -88,11 +91,16 @@ public:
 
 private:
     bool abilityUseCheck(AbilityMap::iterator it);
+    void startRecharge(AbilityValue &ability, int ticks);
+    void abilityRecharged(int id);
 
     Timeout mGlobalCooldown;
 
     AbilityMap mAbilities;
 
+    /** Abilities that recharged since the last update */
+    std::vector<int> mRechargedAbilities;
+
     // Variables required for informing clients
     int mLastUsedAbilityId;
     Point mLastTargetPoint;
@@ -31,6 +31,7 @@
 #include "game-server/postman.h"
 #include "game-server/quest.h"
 #include "game-server/state.h"
+#include "game-server/tickprofiler.h"
 #include "net/messagein.h"
 #include "utils/logger.h"
 #include "utils/tokendispenser.h"
@@ -383,6 +384,29 @@ void AccountConnection::sendStatistics()
         }
     }
     send(msg);
+
+    // The tick times have their own message, so that account servers not
+    // knowing about them still read the statistics above
+    MessageOut tickMsg(GAMSG_TICK_STATISTICS);
+    tickMsg.writeInt8(NB_TICK_PHASES);
+    for (int phase = 0; phase < NB_TICK_PHASES; ++phase)
+    {
+        TickPhase p = static_cast< TickPhase >(phase);
+        tickMsg.writeInt32(TickProfiler::getPercentile(p, 50));
+        tickMsg.writeInt32(TickProfiler::getPercentile(p, 95));
+        tickMsg.writeInt32(TickProfiler::getPercentile(p, 99));
+    }
+
+    for (MapManager::Maps::const_iterator i = maps.begin(),
+         i_end = maps.end(); i != i_end; ++i)
+    {
+        if (!i->second->isActive()) continue;
+        tickMsg.writeInt16(i->first);
+        tickMsg.writeInt32(TickProfiler::getMapPercentile(i->first, 50));
+        tickMsg.writeInt32(TickProfiler::getMapPercentile(i->first, 95));
+        tickMsg.writeInt32(TickProfiler::getMapPercentile(i->first, 99));
+    }
+    send(tickMsg);
 }
 
 void AccountConnection::sendPost(Entity *c, MessageIn &msg)
@@ -441,9 +465,7 @@ void AccountConnection::syncChanges(bool force)
                 << mSyncMessages << " messages." );
 
         send(*mSyncBuffer);
-        delete mSyncBuffer;
-
-        mSyncBuffer = new MessageOut(GAMSG_PLAYER_SYNC);
+        mSyncBuffer->reset(GAMSG_PLAYER_SYNC);
         mSyncMessages = 0;
     }
     else
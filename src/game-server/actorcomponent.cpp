@@ -22,23 +22,67 @@
 
 #include "game-server/map.h"
 #include "game-server/mapcomposite.h"
+#include "net/messageout.h"
 
 #include <cassert>
 
 ActorComponent::ActorComponent(Entity &entity):
     mMoveTime(0),
     mUpdateFlags(0),
+    mHasCachedMessages(false),
     mPublicID(65535),
+    mZoneSlot(0),
     mSize(0),
     mWalkMask(0),
     mBlockType(BLOCKTYPE_NONE)
 {
+    for (int i = 0; i < NB_ACTORMSGS; ++i)
+        mCachedMessages[i] = nullptr;
+
     entity.signal_removed.connect(
             sigc::mem_fun(this, &ActorComponent::removed));
     entity.signal_map_changed.connect(
             sigc::mem_fun(this, &ActorComponent::mapChanged));
 }
 
+ActorComponent::~ActorComponent()
+{
+    dropCachedMessages(~0);
+}
+
+void ActorComponent::setCachedMessage(ActorMessage type, MessageOut *msg)
+{
+    delete mCachedMessages[type];
+    mCachedMessages[type] = msg;
+    mHasCachedMessages = true;
+}
+
+void ActorComponent::dropCachedMessages(int flags)
+{
+    // Flags the content of each cached message depends on
+    static const int dependencies[NB_ACTORMSGS] = {
+        UPDATEFLAG_ACTIONCHANGE | UPDATEFLAG_LOOKSCHANGE |
+                UPDATEFLAG_DIRCHANGE | UPDATEFLAG_NEW_DESTINATION,
+        UPDATEFLAG_LOOKSCHANGE,
+        UPDATEFLAG_ACTIONCHANGE,
+        UPDATEFLAG_DIRCHANGE
+    };
+
+    mHasCachedMessages = false;
+    for (int i = 0; i < NB_ACTORMSGS; ++i)
+    {
+        if (dependencies[i] & flags)
+        {
+            delete mCachedMessages[i];
+            mCachedMessages[i] = nullptr;
+        }
+        else if (mCachedMessages[i])
+        {
+            mHasCachedMessages = true;
+        }
+    }
+}
+
 void ActorComponent::removed(Entity *entity)
 {
     // Free the map position
@@ -69,6 +113,10 @@ void ActorComponent::setPosition(Entity &entity, const Point &p)
         }
     }
 
+    // The enter message contains the position
+    if (mPos != p)
+        invalidateCachedMessages(UPDATEFLAG_NEW_DESTINATION);
+
     mPos = p;
 }
 
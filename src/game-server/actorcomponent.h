@@ -25,6 +25,8 @@
 #include "game-server/entity.h"
 #include "utils/point.h"
 
+class MessageOut;
+
 /**
  * Flags that are raised as necessary. They trigger messages that are sent to
  * the clients.
@@ -43,17 +45,32 @@ enum
     UPDATEFLAG_ABILITY_ON_DIRECTION = 512,
 };
 
+/**
+ * Messages about an actor that are identical for every client receiving them.
+ * They are encoded once per tick and then sent to all the clients around.
+ */
+enum ActorMessage
+{
+    ACTORMSG_ENTER = 0,
+    ACTORMSG_LOOKS,
+    ACTORMSG_ACTION,
+    ACTORMSG_DIRECTION,
+    NB_ACTORMSGS
+};
+
 /**
  * Generic client-visible object. Keeps track of position, size and what to
  * update clients about.
  */
-class ActorComponent : public Component
+class ActorComponent : public PooledComponent<ActorComponent>
 {
     public:
         static const ComponentType type = CT_Actor;
 
         ActorComponent(Entity &entity);
 
+        ~ActorComponent();
+
         void update(Entity &entity)
         {}
 
@@ -85,13 +102,45 @@ class ActorComponent : public Component
          * Sets some changes in the actor.
          */
         void raiseUpdateFlags(int n)
-        { mUpdateFlags |= n; }
+        {
+            mUpdateFlags |= n;
+            invalidateCachedMessages(n);
+        }
 
         /**
-         * Clears changes in the actor.
+         * Clears changes in the actor. Also drops the messages cached during
+         * the current tick.
          */
         void clearUpdateFlags()
-        { mUpdateFlags = 0; }
+        {
+            mUpdateFlags = 0;
+            invalidateCachedMessages(~0);
+        }
+
+        /**
+         * Gets a message about the actor that was already encoded during the
+         * current tick.
+         *
+         * @return the message, or null when it has to be encoded.
+         */
+        MessageOut *getCachedMessage(ActorMessage type) const
+        { return mCachedMessages[type]; }
+
+        /**
+         * Stores a message about the actor, so that it does not need to be
+         * encoded again for every client. Takes ownership of the message.
+         */
+        void setCachedMessage(ActorMessage type, MessageOut *msg);
+
+        /**
+         * Drops the cached enter message, for changes to what it contains
+         * that raise no update flag, like the name or the gender.
+         */
+        void invalidateEnterMessage()
+        {
+            // Only the enter message depends on the destination
+            invalidateCachedMessages(UPDATEFLAG_NEW_DESTINATION);
+        }
 
         /**
          * Sets actor bounding circle radius.
@@ -111,11 +160,27 @@ class ActorComponent : public Component
          * Set public ID. The actor shall not have any public ID yet.
          */
         void setPublicID(int id)
-        { mPublicID = id; }
+        {
+            mPublicID = id;
+            invalidateEnterMessage();
+        }
 
         bool isPublicIdValid() const
         { return (mPublicID > 0 && mPublicID != 65535); }
 
+        /**
+         * Sets the index of the actor in the objects of its map zone. Only
+         * meant to be used by the map zone.
+         */
+        void setZoneSlot(unsigned slot)
+        { mZoneSlot = slot; }
+
+        /**
+         * Gets the index of the actor in the objects of its map zone.
+         */
+        unsigned getZoneSlot() const
+        { return mZoneSlot; }
+
         void setWalkMask(unsigned char mask)
         { mWalkMask = mask; }
 
@@ -145,11 +210,29 @@ class ActorComponent : public Component
         unsigned short mMoveTime;
 
     private:
+        /**
+         * Drops the cached messages that are affected by the given update
+         * flags.
+         */
+        void invalidateCachedMessages(int flags)
+        {
+            if (mHasCachedMessages)
+                dropCachedMessages(flags);
+        }
+
+        void dropCachedMessages(int flags);
+
         int mUpdateFlags;           /**< Changes in actor status. */
 
+        /** Messages encoded during the current tick. */
+        MessageOut *mCachedMessages[NB_ACTORMSGS];
+        bool mHasCachedMessages;
+
         /** Actor ID sent to clients (unique with respect to the map). */
         unsigned short mPublicID;
 
+        unsigned mZoneSlot;         /**< Index in the objects of its zone. */
+
         Point mPos;                 /**< Coordinates. */
         unsigned char mSize;        /**< Radius of bounding circle. */
 
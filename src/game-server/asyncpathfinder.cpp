@@ -0,0 +1,132 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/asyncpathfinder.h"
+
+#include "common/configuration.h"
+#include "utils/logger.h"
+#include "utils/workerpool.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * Number of threads searching for paths, or 0 to search for them directly
+ * while moving the beings.
+ */
+static Configuration::IntOption pathThreadsOption("game_pathThreads", 0);
+
+/** Threads running the searches, created once when enabled. */
+static utils::WorkerPool *pathWorkers;
+
+typedef std::pair<const Map *, std::shared_ptr<PathRequest> > PendingRequest;
+
+/** Searches requested since the last dispatch. */
+static std::vector<PendingRequest> pendingRequests;
+static std::mutex pendingRequestsMutex;
+
+PathRequest::PathRequest(const Point &start, const Point &dest,
+                         unsigned char walkmask, int maxCost,
+                         PathAlgorithm algorithm):
+    start(start),
+    dest(dest),
+    walkmask(walkmask),
+    maxCost(maxCost),
+    algorithm(algorithm),
+    done(false)
+{
+}
+
+/**
+ * Runs one search on a copy of a map.
+ */
+struct PathJob
+{
+    PathJob(const std::shared_ptr<const Map> &map,
+            const std::shared_ptr<PathRequest> &request):
+        map(map),
+        request(request)
+    {}
+
+    void operator()() const
+    {
+        PathRequest &r = *request;
+        r.path = map->findPath(r.start.x, r.start.y, r.dest.x, r.dest.y,
+                               r.walkmask, r.maxCost, r.algorithm);
+        r.done.store(true, std::memory_order_release);
+    }
+
+    std::shared_ptr<const Map> map;
+    std::shared_ptr<PathRequest> request;
+};
+
+void AsyncPathFinder::initialize()
+{
+    const int threads = pathThreadsOption;
+    if (threads > 0 && !pathWorkers)
+    {
+        LOG_INFO("Searching for paths with " << threads << " threads.");
+        pathWorkers = new utils::WorkerPool(threads);
+    }
+}
+
+bool AsyncPathFinder::isEnabled()
+{
+    return pathWorkers != nullptr;
+}
+
+std::shared_ptr<PathRequest> AsyncPathFinder::request(const Map *map,
+                                                      const Point &start,
+                                                      const Point &dest,
+                                                      unsigned char walkmask,
+                                                      int maxCost)
+{
+    // The algorithm is chosen now, since the configuration may change while
+    // the search runs.
+    std::shared_ptr<PathRequest> request(
+            new PathRequest(start, dest, walkmask, maxCost,
+                            Map::getDefaultPathAlgorithm()));
+
+    std::lock_guard<std::mutex> lock(pendingRequestsMutex);
+    pendingRequests.push_back(PendingRequest(map, request));
+    return request;
+}
+
+void AsyncPathFinder::dispatch()
+{
+    if (!pathWorkers || pendingRequests.empty())
+        return;
+
+    // All the searches on a map share a single copy of it.
+    std::map<const Map *, std::shared_ptr<const Map> > copies;
+
+    for (std::vector<PendingRequest>::iterator it = pendingRequests.begin(),
+         it_end = pendingRequests.end(); it != it_end; ++it)
+    {
+        std::shared_ptr<const Map> &copy = copies[it->first];
+        if (!copy)
+            copy.reset(it->first->copyWalkability());
+
+        pathWorkers->enqueue(PathJob(copy, it->second));
+    }
+
+    pendingRequests.clear();
+}
@@ -0,0 +1,104 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASYNCPATHFINDER_H
+#define ASYNCPATHFINDER_H
+
+#include "game-server/map.h"
+
+#include <atomic>
+#include <memory>
+
+/**
+ * A path search run on one of the path finding threads.
+ */
+struct PathRequest
+{
+    PathRequest(const Point &start, const Point &dest,
+                unsigned char walkmask, int maxCost,
+                PathAlgorithm algorithm);
+
+    /**
+     * Tells whether this is a search for the given path.
+     */
+    bool matches(const Point &start, const Point &dest,
+                 unsigned char walkmask, int maxCost) const
+    {
+        return this->start == start && this->dest == dest &&
+               this->walkmask == walkmask && this->maxCost == maxCost;
+    }
+
+    Point start;
+    Point dest;
+    unsigned char walkmask;
+    int maxCost;
+    PathAlgorithm algorithm;
+
+    Path path;      /**< The path found, once done. */
+
+    /**
+     * Set by the searching thread once the path is found, with release
+     * ordering, so that the path can be read after loading it with acquire
+     * ordering.
+     */
+    std::atomic<bool> done;
+};
+
+/**
+ * Runs path searches on their own threads, so that slow searches do not hold
+ * up the world tick.
+ *
+ * The searches requested during a tick are started at its end, on a copy of
+ * the walkability of their map at that time. The tick does not wait for
+ * them: each being picks up its path at the first tick after its search is
+ * done, so a slow search only holds up the being waiting for it.
+ */
+namespace AsyncPathFinder
+{
+    /**
+     * Starts the threads for path searches when the game_pathThreads option
+     * is set, which is only read here.
+     */
+    void initialize();
+
+    /**
+     * Tells whether there are threads for path searches, as set by the
+     * game_pathThreads option. Otherwise paths have to be searched for
+     * directly.
+     */
+    bool isEnabled();
+
+    /**
+     * Requests a path search on the given map. May be called while updating
+     * maps on several threads.
+     */
+    std::shared_ptr<PathRequest> request(const Map *map,
+                                         const Point &start,
+                                         const Point &dest,
+                                         unsigned char walkmask,
+                                         int maxCost);
+
+    /**
+     * Starts the searches requested during this tick.
+     */
+    void dispatch();
+}
+
+#endif // ASYNCPATHFINDER_H
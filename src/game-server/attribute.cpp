@@ -20,6 +20,7 @@
 
 #include "attribute.h"
 #include "game-server/being.h"
+#include "game-server/state.h"
 #include "utils/logger.h"
 #include <cassert>
 
@@ -47,7 +48,7 @@ AttributeModifiersEffect::~AttributeModifiersEffect()
     LOG_WARN("DELETION of attribute effect!");
 }
 
-bool AttributeModifiersEffect::add(unsigned short duration,
+bool AttributeModifiersEffect::add(int expiry,
                                    double value,
                                    double prevLayerValue,
                                    int level)
@@ -56,7 +57,7 @@ bool AttributeModifiersEffect::add(unsigned short duration,
               " with a previous layer value of " << prevLayerValue << ". "
               "Current mod at this layer: " << mMod << ".");
     bool ret = false;
-    mStates.push_back(new AttributeModifierState(duration, value, level));
+    mStates.push_back(new AttributeModifierState(expiry, value, level));
     switch (mStackableType) {
     case Stackable:
         switch (mEffectType) {
@@ -130,7 +131,7 @@ bool AttributeModifiersEffect::add(unsigned short duration,
 bool durationCompare(const AttributeModifierState *lhs,
                      const AttributeModifierState *rhs)
 {
-    return lhs->mDuration < rhs->mDuration;
+    return lhs->mExpiry < rhs->mExpiry;
 }
 
 bool AttributeModifiersEffect::remove(double value, unsigned id,
@@ -143,7 +144,7 @@ bool AttributeModifiersEffect::remove(double value, unsigned id,
     bool ret = false;
 
     for (std::list< AttributeModifierState * >::iterator it = mStates.begin();
-         it != mStates.end() && (fullCheck || !(*it)->mDuration);)
+         it != mStates.end() && (fullCheck || !(*it)->mExpiry);)
     {
         /* Check for a match */
         if ((*it)->mValue != value || (*it)->mId != id)
@@ -256,7 +257,8 @@ bool Attribute::add(unsigned short duration, double value,
               << ", value " << value
               << ", at layer " << layer
               << " with id " << id);
-    if (mMods.at(layer)->add(duration, value,
+    const int expiry = duration ? GameState::getCurrentTick() + duration : 0;
+    if (mMods.at(layer)->add(expiry, value,
                             (layer ? mMods.at(layer - 1)->getCachedModifiedValue()
                                    : mBase)
                             , id))
@@ -294,13 +296,13 @@ bool Attribute::remove(double value, unsigned layer,
     return false;
 }
 
-bool AttributeModifiersEffect::tick()
+bool AttributeModifiersEffect::expire(int tick)
 {
     bool ret = false;
     std::list<AttributeModifierState *>::iterator it = mStates.begin();
     while (it != mStates.end())
     {
-        if ((*it)->tick())
+        if ((*it)->expired(tick))
         {
             double value = (*it)->mValue;
             LOG_DEBUG("Modifier of value " << value << " expiring!");
@@ -309,11 +311,30 @@ bool AttributeModifiersEffect::tick()
             updateMod(value);
             ret = true;
         }
-        ++it;
+        else
+        {
+            ++it;
+        }
     }
     return ret;
 }
 
+int AttributeModifiersEffect::nextExpiry() const
+{
+    int next = 0;
+    for (std::list<AttributeModifierState *>::const_iterator
+         it = mStates.begin(),
+         it_end = mStates.end();
+         it != it_end;
+         ++it)
+    {
+        const int expiry = (*it)->mExpiry;
+        if (expiry && (!next || expiry < next))
+            next = expiry;
+    }
+    return next;
+}
+
 Attribute::Attribute(const AttributeInfo *info):
     mBase(0),
     mMinValue(info->minimum),
@@ -344,14 +365,14 @@ Attribute::~Attribute()
 //    }
 }
 
-bool Attribute::tick()
+bool Attribute::expire(int tick)
 {
     bool ret = false;
     double prev = mBase;
     for (std::vector<AttributeModifiersEffect *>::iterator it = mMods.begin(),
         it_end = mMods.end(); it != it_end; ++it)
     {
-        if ((*it)->tick())
+        if ((*it)->expire(tick))
         {
             LOG_DEBUG("Attribute layer " << mMods.begin() - it
                       << " has expiring modifiers.");
@@ -364,6 +385,19 @@ bool Attribute::tick()
     return ret;
 }
 
+int Attribute::nextExpiry() const
+{
+    int next = 0;
+    for (std::vector<AttributeModifiersEffect *>::const_iterator
+         it = mMods.begin(), it_end = mMods.end(); it != it_end; ++it)
+    {
+        const int expiry = (*it)->nextExpiry();
+        if (expiry && (!next || expiry < next))
+            next = expiry;
+    }
+    return next;
+}
+
 void Attribute::clearMods()
 {
     for (std::vector<AttributeModifiersEffect *>::iterator it = mMods.begin(),
@@ -29,19 +29,20 @@
 class AttributeModifierState
 {
     public:
-        AttributeModifierState(unsigned short duration,
+        AttributeModifierState(int expiry,
                                double value,
                                unsigned id)
-            : mDuration(duration)
+            : mExpiry(expiry)
             , mValue(value)
             , mId(id)
         {}
 
-        bool tick() { return mDuration ? !--mDuration : false; }
+        bool expired(int tick) const { return mExpiry && mExpiry <= tick; }
 
     private:
-        /** Number of ticks (0 means permanent, e.g. equipment). */
-        unsigned short mDuration;
+        /** Tick at which the modifier expires (0 means permanent, e.g.
+         *  equipment). */
+        int mExpiry;
         const double mValue;   /**< Positive or negative amount. */
         /**
          * Special purpose variable used to identify this effect to
@@ -69,7 +70,7 @@ class AttributeModifiersEffect
          * If this returns true, the cached values for *all* modifiers of a
          *     higher level must be recalculated, as well as the final
          */
-        bool add(unsigned short duration, double value,
+        bool add(int expiry, double value,
                  double prevLayerValue, int level);
 
         /**
@@ -98,7 +99,17 @@ class AttributeModifiersEffect
 
         double getCachedModifiedValue() const { return mCacheVal; }
 
-        bool tick();
+        /**
+         * Removes the modifiers that expired at the given tick.
+         * @returns Whether any modifier was removed.
+         */
+        bool expire(int tick);
+
+        /**
+         * Returns the tick at which the next modifier of this layer expires,
+         * or 0 when none of them expires.
+         */
+        int nextExpiry() const;
 
         /**
          * clearMods() - removes all modifications present in this layer.
@@ -183,9 +194,17 @@ class Attribute
         void clearMods();
 
         /**
-         * tick() processes all timers associated with modifiers for this attribute.
+         * expire() removes the modifiers of this attribute that expired at
+         * the given tick.
+         * @returns Whether the modified attribute value was changed.
+         */
+        bool expire(int tick);
+
+        /**
+         * Returns the tick at which the next modifier of this attribute
+         * expires, or 0 when none of them expires.
          */
-        bool tick();
+        int nextExpiry() const;
 
     private:
         /**
@@ -59,6 +59,7 @@ struct AttributeInfo
 {
     AttributeInfo(int id, const std::string &name):
         id(id),
+        index(0),
         name(name),
         persistent(false),
         minimum(std::numeric_limits<double>::min()),
@@ -67,6 +68,7 @@ struct AttributeInfo
     {}
 
     int id;
+    unsigned index;     /**< Dense index, below the number of attributes. */
     std::string name;
     bool persistent;
     double minimum;
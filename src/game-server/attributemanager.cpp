@@ -43,20 +43,12 @@ void AttributeManager::deinitialize()
     for (auto &it : mAttributeMap)
         delete it.second;
     mAttributeMap.clear();
+    mAttributesById.clear();
 
     for (unsigned i = 0; i < MaxScope; ++i)
         mAttributeScopes[i].clear();
 }
 
-AttributeInfo *AttributeManager::getAttributeInfo(
-        int id) const
-{
-    auto ret = mAttributeMap.find(id);
-    if (ret == mAttributeMap.end())
-        return 0;
-    return ret->second;
-}
-
 AttributeInfo *AttributeManager::getAttributeInfo(
         const std::string &name) const
 {
@@ -167,6 +159,17 @@ void AttributeManager::readAttributeNode(xmlNodePtr attributeNode)
         }
     }
 
+    // A redefined attribute takes the index of the previous definition.
+    auto existing = mAttributeMap.find(id);
+    if (existing != mAttributeMap.end())
+        attribute->index = existing->second->index;
+    else
+        attribute->index = mAttributeMap.size();
+
+    if (id >= (int) mAttributesById.size())
+        mAttributesById.resize(id + 1, 0);
+    mAttributesById[id] = attribute;
+
     mAttributeMap[id] = attribute;
     mAttributeNameMap[name] = attribute;
 }
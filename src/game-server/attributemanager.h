@@ -78,6 +78,13 @@ class AttributeManager
         AttributeInfo *getAttributeInfo(int id) const;
         AttributeInfo *getAttributeInfo(const std::string &name) const;
 
+        /**
+         * Gets the number of attributes. The dense indexes of the attributes
+         * are below this number.
+         */
+        unsigned getAttributeCount() const
+        { return mAttributeMap.size(); }
+
         const std::set<AttributeInfo *> &getAttributeScope(ScopeType) const;
 
         ModifierLocation getLocation(const std::string &tag) const;
@@ -95,11 +102,19 @@ class AttributeManager
         std::set<AttributeInfo *> mAttributeScopes[MaxScope];
 
         std::map<int, AttributeInfo *> mAttributeMap;
+        std::vector<AttributeInfo *> mAttributesById;  /**< For quick lookup */
         utils::NameMap<AttributeInfo *> mAttributeNameMap;
 
         std::map<std::string, ModifierLocation> mTagMap;
 };
 
+inline AttributeInfo *AttributeManager::getAttributeInfo(int id) const
+{
+    if (id < 0 || id >= (int) mAttributesById.size())
+        return 0;
+    return mAttributesById[id];
+}
+
 extern AttributeManager *attributeManager;
 
 #endif // ATTRIBUTEMANAGER_H
@@ -24,17 +24,27 @@
 
 #include "common/configuration.h"
 #include "common/defines.h"
+#include "game-server/asyncpathfinder.h"
 #include "game-server/attributemanager.h"
 #include "game-server/charactercomponent.h"
 #include "game-server/collisiondetection.h"
 #include "game-server/mapcomposite.h"
+#include "game-server/state.h"
 #include "game-server/effect.h"
+#include "game-server/flowfield.h"
 #include "game-server/statuseffect.h"
 #include "game-server/statusmanager.h"
 #include "utils/logger.h"
 #include "utils/speedconv.h"
 #include "scripting/scriptmanager.h"
 
+/* Maximum cost in tiles of the paths looked for tile by tile. Destinations
+   further away are reached through a route. */
+static int const localPathRange = 20;
+
+/* Extra cost in tiles allowed for walking around beings between two
+   waypoints of a route. */
+static int const routeDetour = 4;
 
 Script::Ref BeingComponent::mRecalculateDerivedAttributesCallback;
 Script::Ref BeingComponent::mRecalculateBaseAttributeCallback;
@@ -42,8 +52,12 @@ Script::Ref BeingComponent::mRecalculateBaseAttributeCallback;
 BeingComponent::BeingComponent(Entity &entity):
     mMoveTime(0),
     mAction(STAND),
+    mAttributes(attributeManager->getAttributeCount()),
     mGender(GENDER_UNSPECIFIED),
+    mPathVersion(0),
     mDirection(DOWN),
+    mModifierExpiry(0),
+    mModifiersExpired(false),
     mEmoteId(0)
 {
     auto &attributeScope = attributeManager->getAttributeScope(BeingScope);
@@ -53,7 +67,7 @@ BeingComponent::BeingComponent(Entity &entity):
     {
         LOG_DEBUG("Attempting to create attribute '"
                   << attribute->id << "'.");
-        mAttributes.insert(std::make_pair(attribute, Attribute(attribute)));
+        mAttributes.insert(attribute);
     }
 
     clearDestination(entity);
@@ -132,6 +146,8 @@ void BeingComponent::setDestination(Entity &entity, const Point &dst)
     entity.getComponent<ActorComponent>()->raiseUpdateFlags(
             UPDATEFLAG_NEW_DESTINATION);
     mPath.clear();
+    mRoute.clear();
+    mPathRequest.reset();
 }
 
 void BeingComponent::clearDestination(Entity &entity)
@@ -157,9 +173,82 @@ Path BeingComponent::findPath(Entity &entity)
     int startX = actorComponent->getPosition().x / tileWidth;
     int startY = actorComponent->getPosition().y / tileHeight;
     int destX = mDst.x / tileWidth, destY = mDst.y / tileHeight;
+    const unsigned char walkmask = actorComponent->getWalkMask();
+    const Point start(startX, startY);
+
+    // A pending search is kept while it is the one still needed, and
+    // dropped otherwise.
+    std::shared_ptr<PathRequest> request;
+    request.swap(mPathRequest);
+
+    // Skip the waypoints that were reached
+    while (!mRoute.empty() && mRoute.front().tile == Point(startX, startY))
+        mRoute.pop_front();
+
+    // Beyond the reach of a path search, plan a route through the whole map.
+    // It only avoids walls, so beings walking through them do without.
+    if (mRoute.empty() && (walkmask & Map::BLOCKMASK_WALL) &&
+        std::max(std::abs(destX - startX),
+                 std::abs(destY - startY)) > localPathRange)
+    {
+        mRoute = map->findRoute(startX, startY, destX, destY);
+    }
+
+    if (!mRoute.empty())
+    {
+        const Waypoint &next = mRoute.front();
+        return searchPath(map, request, start, next.tile, walkmask,
+                          next.maxCost + routeDetour);
+    }
+
+    // Beings walking to the same tile share their search
+    Path path;
+    FlowFields *flowFields = entity.getMap()->getFlowFields();
+    if (flowFields->findPath(startX, startY, destX, destY, walkmask,
+                             localPathRange, path))
+        return path;
+
+    return searchPath(map, request, start, Point(destX, destY), walkmask,
+                      localPathRange);
+}
+
+Path BeingComponent::searchPath(const Map *map,
+                                const std::shared_ptr<PathRequest> &request,
+                                const Point &start, const Point &dest,
+                                unsigned char walkmask, int maxCost)
+{
+    if (!AsyncPathFinder::isEnabled())
+        return map->findPath(start.x, start.y, dest.x, dest.y,
+                             walkmask, maxCost);
+
+    if (request && request->matches(start, dest, walkmask, maxCost))
+    {
+        // Keep waiting for a search that is still running
+        if (!request->done.load(std::memory_order_acquire))
+        {
+            mPathRequest = request;
+            return Path();
+        }
 
-    return map->findPath(startX, startY, destX, destY,
-                         actorComponent->getWalkMask());
+        // The map may have changed since the search started
+        bool walkable = true;
+        for (Path::const_iterator it = request->path.begin(),
+             it_end = request->path.end(); it != it_end && walkable; ++it)
+        {
+            walkable = map->getWalk(it->x, it->y, walkmask);
+        }
+
+        if (walkable)
+        {
+            Path path;
+            path.swap(request->path);
+            return path;
+        }
+    }
+
+    mPathRequest = AsyncPathFinder::request(map, start, dest, walkmask,
+                                            maxCost);
+    return Path();
 }
 
 void BeingComponent::updateDirection(Entity &entity,
@@ -224,37 +313,47 @@ void BeingComponent::move(Entity &entity)
         return;
     }
 
-    /* If no path exists, the for-loop won't be entered. Else a path for the
-     * current destination has already been calculated.
-     * The tiles in this path have to be checked for walkability,
-     * in case there have been changes. The 'getWalk' method of the Map
-     * class has been used, because that seems to be the most logical
-     * place extra functionality will be added.
+    /* The tiles of the path found earlier have to be checked for
+     * walkability, but only when tiles blocking this being have changed
+     * since the last time.
      */
-    for (Point &point : mPath)
+    const unsigned char walkmask =
+            entity.getComponent<ActorComponent>()->getWalkMask();
+    const unsigned walkVersion = map->getWalkVersion(walkmask);
+    if (mPathVersion != walkVersion)
     {
-        const unsigned char walkmask =
-                entity.getComponent<ActorComponent>()->getWalkMask();
-        if (!map->getWalk(point.x, point.y, walkmask))
+        for (Point &point : mPath)
         {
-            mPath.clear();
-            break;
+            if (!map->getWalk(point.x, point.y, walkmask))
+            {
+                mPath.clear();
+                break;
+            }
         }
+        mPathVersion = walkVersion;
     }
 
     if (mPath.empty())
     {
         // No path exists: the walkability of cached path has changed, the
-        // destination has changed, or a path was never set.
+        // destination has changed, or a path was never set. The new path
+        // is walkable on the map as it is now.
         mPath = findPath(entity);
     }
 
+    if (mPath.empty() && mPathRequest)
+    {
+        // Hold position while the path is searched for on another thread
+        mMoveTime = 0;
+        return;
+    }
+
     if (mPath.empty())
     {
         if (mAction == WALK)
             setAction(entity, STAND);
         // no path was found
-        mDst = mOld;
+        clearDestination(entity);
         mMoveTime = 0;
         return;
     }
@@ -274,7 +373,7 @@ void BeingComponent::move(Entity &entity)
                        getModifiedAttribute(rawSpeedAttribute) :
                        getModifiedAttribute(rawSpeedAttribute) * SQRT2;
 
-        if (mPath.empty())
+        if (mPath.empty() && next.x == tileDX && next.y == tileDY)
         {
             // skip last tile center
             pos = mDst;
@@ -285,7 +384,8 @@ void BeingComponent::move(Entity &entity)
         pos.x = next.x * tileWidth + (tileWidth / 2);
         pos.y = next.y * tileHeight + (tileHeight / 2);
     }
-    while (mMoveTime < WORLD_TICK_MS);
+    // A path to a waypoint ends before the destination
+    while (mMoveTime < WORLD_TICK_MS && !mPath.empty());
     entity.getComponent<ActorComponent>()->setPosition(entity, pos);
 
     mMoveTime = mMoveTime > WORLD_TICK_MS ? mMoveTime - WORLD_TICK_MS : 0;
@@ -323,6 +423,9 @@ void BeingComponent::applyModifier(Entity &entity, AttributeInfo *attribute,
 {
     mAttributes.at(attribute).add(duration, value, layer, id);
     updateDerivedAttributes(entity, attribute);
+
+    if (duration)
+        scheduleModifierExpiry(GameState::getCurrentTick() + duration);
 }
 
 bool BeingComponent::removeModifier(Entity &entity, AttributeInfo *attribute,
@@ -334,17 +437,24 @@ bool BeingComponent::removeModifier(Entity &entity, AttributeInfo *attribute,
     return ret;
 }
 
-void BeingComponent::setGender(BeingGender gender)
+void BeingComponent::setGender(Entity &entity, BeingGender gender)
 {
     mGender = gender;
+    entity.getComponent<ActorComponent>()->invalidateEnterMessage();
+}
+
+void BeingComponent::setName(Entity &entity, const std::string &name)
+{
+    mName = name;
+    entity.getComponent<ActorComponent>()->invalidateEnterMessage();
 }
 
 void BeingComponent::setAttribute(Entity &entity,
                                   AttributeInfo *attribute,
                                   double value)
 {
-    auto attributeIt = mAttributes.find(attribute);
-    if (attributeIt == mAttributes.end())
+    Attribute *attributeValue = mAttributes.find(attribute);
+    if (!attributeValue)
     {
         /*
          * The attribute does not yet exist, so we must attempt to create it.
@@ -356,52 +466,51 @@ void BeingComponent::setAttribute(Entity &entity,
     }
     else
     {
-        attributeIt->second.setBase(value);
+        attributeValue->setBase(value);
         updateDerivedAttributes(entity, attribute);
     }
 }
 
 void BeingComponent::createAttribute(AttributeInfo *attributeInfo)
 {
-    mAttributes.insert(std::pair<AttributeInfo *, Attribute>
-            (attributeInfo, Attribute(attributeInfo)));
+    mAttributes.insert(attributeInfo);
 }
 
 const Attribute *BeingComponent::getAttribute(AttributeInfo *attribute) const
 {
-    AttributeMap::const_iterator ret = mAttributes.find(attribute);
-    if (ret == mAttributes.end())
+    const Attribute *ret = mAttributes.find(attribute);
+    if (!ret)
     {
         LOG_DEBUG("BeingComponent::getAttribute: Attribute "
                   << attribute->id << " not found! Returning 0.");
         return 0;
     }
-    return &ret->second;
+    return ret;
 }
 
 double BeingComponent::getAttributeBase(AttributeInfo *attribute) const
 {
-    AttributeMap::const_iterator ret = mAttributes.find(attribute);
-    if (ret == mAttributes.end())
+    const Attribute *ret = mAttributes.find(attribute);
+    if (!ret)
     {
         LOG_DEBUG("BeingComponent::getAttributeBase: Attribute "
                   << attribute->id << " not found! Returning 0.");
         return 0;
     }
-    return ret->second.getBase();
+    return ret->getBase();
 }
 
 
 double BeingComponent::getModifiedAttribute(AttributeInfo *attribute) const
 {
-    AttributeMap::const_iterator ret = mAttributes.find(attribute);
-    if (ret == mAttributes.end())
+    const Attribute *ret = mAttributes.find(attribute);
+    if (!ret)
     {
         LOG_DEBUG("BeingComponent::getModifiedAttribute: Attribute "
                   << attribute->id << " not found! Returning 0.");
         return 0;
     }
-    return ret->second.getModifiedAttribute();
+    return ret->getModifiedAttribute();
 }
 
 void BeingComponent::recalculateBaseAttribute(Entity &entity,
@@ -542,14 +651,9 @@ void BeingComponent::update(Entity &entity)
                 UPDATEFLAG_HEALTHCHANGE);
     }
 
-    // Update lifetime of effects.
-    for (AttributeMap::iterator it = mAttributes.begin();
-         it != mAttributes.end();
-         ++it)
-    {
-        if (it->second.tick())
-            updateDerivedAttributes(entity, it->first);
-    }
+    // Remove expired modifiers
+    if (mModifiersExpired)
+        expireModifiers(entity);
 
     // Update and run status effects
     StatusEffects::iterator it = mStatus.begin();
@@ -576,6 +680,44 @@ void BeingComponent::update(Entity &entity)
         died(entity);
 }
 
+void BeingComponent::scheduleModifierExpiry(int expiry)
+{
+    if (mModifierTimer.isActive() && mModifierExpiry <= expiry)
+        return;
+
+    mModifierExpiry = expiry;
+    mModifierTimer.start(expiry - GameState::getCurrentTick(),
+                         sigc::mem_fun(this,
+                                       &BeingComponent::modifiersExpired));
+}
+
+void BeingComponent::modifiersExpired()
+{
+    mModifiersExpired = true;
+}
+
+void BeingComponent::expireModifiers(Entity &entity)
+{
+    mModifiersExpired = false;
+
+    const int tick = GameState::getCurrentTick();
+    int next = 0;
+    for (AttributeMap::iterator it = mAttributes.begin();
+         it != mAttributes.end();
+         ++it)
+    {
+        if (it->second.expire(tick))
+            updateDerivedAttributes(entity, it->first);
+
+        const int expiry = it->second.nextExpiry();
+        if (expiry && (!next || expiry < next))
+            next = expiry;
+    }
+
+    if (next)
+        scheduleModifierExpiry(next);
+}
+
 void BeingComponent::inserted(Entity *entity)
 {
     // Reset the old position, since after insertion it is important that it is
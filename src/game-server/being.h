@@ -25,20 +25,105 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <memory>
 #include "limits.h"
+#include <stdexcept>
 
 #include "game-server/actorcomponent.h"
 #include "game-server/attribute.h"
 #include "game-server/attributemanager.h"
 #include "game-server/timeout.h"
+#include "game-server/timerwheel.h"
 
 #include "scripting/script.h"
 
 class BeingComponent;
 class MapComposite;
 class StatusEffect;
+struct PathRequest;
 
-typedef std::map<AttributeInfo *, Attribute> AttributeMap;
+/**
+ * The attributes of a being. They are stored contiguously, and found in
+ * constant time through the dense index of their AttributeInfo.
+ *
+ * Room is made for all the attributes up front, so inserting one never moves
+ * the others: iterators, pointers and references to the attributes stay
+ * valid when scripts create attributes while they are used. This only holds
+ * for the attributes that were defined when the map was built, and not for
+ * those added by a reload of the attributes since.
+ */
+class AttributeMap
+{
+    public:
+        typedef std::pair<AttributeInfo *, Attribute> value_type;
+        typedef std::vector<value_type>::iterator iterator;
+        typedef std::vector<value_type>::const_iterator const_iterator;
+
+        /**
+         * Constructor.
+         *
+         * @param capacity the number of attributes to make room for, which
+         *                 should be AttributeManager::getAttributeCount()
+         */
+        explicit AttributeMap(unsigned capacity):
+            mSlots(capacity, 0)
+        {
+            mAttributes.reserve(capacity);
+        }
+
+        /**
+         * Creates the attribute when it does not exist yet.
+         */
+        void insert(AttributeInfo *info)
+        {
+            if (info->index >= mSlots.size())
+                mSlots.resize(info->index + 1, 0);
+            else if (mSlots[info->index])
+                return;
+
+            mAttributes.push_back(value_type(info, Attribute(info)));
+            mSlots[info->index] = mAttributes.size();
+        }
+
+        /**
+         * Gets an attribute, or null when it does not exist.
+         */
+        Attribute *find(const AttributeInfo *info)
+        {
+            if (info->index >= mSlots.size() || !mSlots[info->index])
+                return 0;
+            return &mAttributes[mSlots[info->index] - 1].second;
+        }
+
+        const Attribute *find(const AttributeInfo *info) const
+        { return const_cast<AttributeMap *>(this)->find(info); }
+
+        /**
+         * Gets an attribute, throwing std::out_of_range when it does not
+         * exist.
+         */
+        Attribute &at(const AttributeInfo *info)
+        {
+            if (Attribute *attribute = find(info))
+                return *attribute;
+            throw std::out_of_range("AttributeMap::at");
+        }
+
+        bool count(const AttributeInfo *info) const
+        { return find(info) != 0; }
+
+        unsigned size() const
+        { return mAttributes.size(); }
+
+        iterator begin() { return mAttributes.begin(); }
+        iterator end() { return mAttributes.end(); }
+        const_iterator begin() const { return mAttributes.begin(); }
+        const_iterator end() const { return mAttributes.end(); }
+
+    private:
+        std::vector<value_type> mAttributes;    /**< In creation order. */
+        std::vector<unsigned short> mSlots;     /**< Position + 1, by index. */
+};
 
 struct Status
 {
@@ -57,7 +142,7 @@ typedef std::vector<unsigned> Hits;
  * Generic being (living actor). Keeps direction, destination and a few other
  * relevant properties. Used for characters & monsters (all animated objects).
  */
-class BeingComponent : public Component
+class BeingComponent : public PooledComponent<BeingComponent>
 {
     public:
         static const ComponentType type = CT_Being;
@@ -130,7 +215,9 @@ class BeingComponent : public Component
         void move(Entity &entity);
 
         /**
-         * Returns the path to the being's current destination.
+         * Returns the path to the being's current destination, or to the
+         * next waypoint on the route to it when it is too far away to be
+         * looked for tile by tile.
          */
         virtual Path findPath(Entity &);
 
@@ -139,7 +226,7 @@ class BeingComponent : public Component
         { return mGender; }
 
         /** Sets the gender of the being (male or female). */
-        void setGender(BeingGender gender);
+        void setGender(Entity &entity, BeingGender gender);
 
         /**
          * Sets an attribute.
@@ -245,8 +332,7 @@ class BeingComponent : public Component
         { return mName; }
 
         /** Sets the name of the being. */
-        void setName(const std::string &name)
-        { mName = name; }
+        void setName(Entity &entity, const std::string &name);
 
         /**
          * Converts a direction to an angle. Used for combat hit checks.
@@ -303,7 +389,38 @@ class BeingComponent : public Component
          */
         void inserted(Entity *);
 
+        /**
+         * Makes sure the modifier timer fires no later than the given tick.
+         */
+        void scheduleModifierExpiry(int expiry);
+
+        /**
+         * Connected to the modifier timer, marks the modifiers for removal
+         * at the next update.
+         */
+        void modifiersExpired();
+
+        /**
+         * Removes the expired modifiers and schedules the next expiry.
+         */
+        void expireModifiers(Entity &entity);
+
+        /**
+         * Looks for a path with Map::findPath, or on the path finding
+         * threads when there are any. In that case the path is only returned
+         * once the search requested for it is done, however many ticks it
+         * takes. Until then an empty path is returned and mPathRequest is
+         * set.
+         */
+        Path searchPath(const Map *map,
+                        const std::shared_ptr<PathRequest> &request,
+                        const Point &start, const Point &dest,
+                        unsigned char walkmask, int maxCost);
+
         Path mPath;
+        unsigned mPathVersion;      /**< Walk version mPath was checked at. */
+        Route mRoute;               /**< Waypoints to a distant destination. */
+        std::shared_ptr<PathRequest> mPathRequest; /**< Pending search. */
         BeingDirection mDirection;   /**< Facing direction. */
 
         std::string mName;
@@ -311,6 +428,11 @@ class BeingComponent : public Component
         /** Time until hp is regenerated again */
         Timeout mHealthRegenerationTimeout;
 
+        /** Fires when the first temporary attribute modifier expires */
+        Timer mModifierTimer;
+        int mModifierExpiry;        /**< Tick the modifier timer fires at. */
+        bool mModifiersExpired;
+
         /** The last being emote Id. Used when triggering a being emoticon. */
         int mEmoteId;
 
@@ -73,6 +73,7 @@ CharacterComponent::CharacterComponent(Entity &entity, MessageIn &msg):
     mCorrectionPoints(0),
     mSendAbilityCooldown(false),
     mParty(0),
+    mPartySlot(0),
     mTransaction(TRANS_NONE),
     mTalkNpcId(0),
     mNpcThread(0),
@@ -102,7 +103,7 @@ CharacterComponent::CharacterComponent(Entity &entity, MessageIn &msg):
 
     // Get character data.
     mDatabaseID = msg.readInt32();
-    beingComponent->setName(msg.readString());
+    beingComponent->setName(entity, msg.readString());
 
     deserialize(entity, msg);
 
@@ -123,7 +124,7 @@ void CharacterComponent::deserialize(Entity &entity, MessageIn &msg)
 
     // general character properties
     setAccountLevel(msg.readInt8());
-    beingComponent->setGender(ManaServ::getGender(msg.readInt8()));
+    beingComponent->setGender(entity, ManaServ::getGender(msg.readInt8()));
     setHairStyle(msg.readInt8());
     setHairColor(msg.readInt8());
     setAttributePoints(msg.readInt16());
@@ -290,6 +291,18 @@ void CharacterComponent::serialize(Entity &entity, MessageOut &msg)
     }
 }
 
+void CharacterComponent::setParty(Entity &entity, int party)
+{
+    if (mParty == party)
+        return;
+
+    const int oldParty = mParty;
+    mParty = party;
+
+    if (MapComposite *map = entity.getMap())
+        map->partyChanged(&entity, oldParty);
+}
+
 void CharacterComponent::characterDied(Entity *being)
 {
     executeCallback(mDeathCallback, *being);
@@ -350,7 +363,7 @@ void CharacterComponent::sendAbilityUpdate(Entity &entity)
             continue; // got deleted
 
         msg.writeInt8(id);
-        msg.writeInt32(it->second.rechargeTimeout.remaining());
+        msg.writeInt32(it->second.rechargeTimer.remaining());
     }
 
     mModifiedAbilities.clear();
@@ -510,7 +523,7 @@ void CharacterComponent::modifiedAllAttributes(Entity &entity)
     auto *beingComponent = entity.getComponent<BeingComponent>();
 
     LOG_DEBUG("Marking all attributes as changed, requiring recalculation.");
-    for (auto attribute : beingComponent->getAttributes())
+    for (auto &attribute : beingComponent->getAttributes())
     {
         beingComponent->recalculateBaseAttribute(entity, attribute.first);
         mModifiedAttributes.insert(attribute.first);
@@ -70,7 +70,7 @@ struct QuestInfo
 /**
  * The representation of a player's character in the game world.
  */
-class CharacterComponent : public Component
+class CharacterComponent : public PooledComponent<CharacterComponent>
 {
     public:
         static const ComponentType type = CT_Character;
@@ -174,9 +174,21 @@ class CharacterComponent : public Component
         int getParty() const
         { return mParty; }
 
-        /** Sets the party id of the character */
-        void setParty(int party)
-        { mParty = party; }
+        /**
+         * Sets the party id of the character. Also updates the party index
+         * of the map the character is on.
+         */
+        void setParty(Entity &entity, int party);
+
+        /**
+         * Sets the position + 1 of the character in the party index of its
+         * map, or 0 when it is not in the index. Only used by MapComposite.
+         */
+        void setPartySlot(unsigned slot)
+        { mPartySlot = slot; }
+
+        unsigned getPartySlot() const
+        { return mPartySlot; }
 
         /**
          * Sends a message that informs the client about attribute
@@ -361,6 +373,7 @@ class CharacterComponent : public Component
         bool mSendAbilityCooldown;
         unsigned char mAccountLevel; /**< Account level of the user. */
         int mParty;                  /**< Party id of the character */
+        unsigned mPartySlot;         /**< Position + 1 in the party index. */
         TransactionType mTransaction; /**< Trade/buy/sell action the character is involved in. */
         std::map<int, int> mKillCount;  /**< How many monsters the character has slain of each type */
 
@@ -0,0 +1,483 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/clustergraph.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+
+// Step costs, the same as the ones of Map::findPath.
+static int const basicCost = 100;
+static int const diagonalCost = basicCost * 362 / 256;
+static int const straightCost = basicCost + 1;
+
+// Entrances at least this wide get a node at each end instead of a single one
+// in the middle, so that routes do not have to make a detour to the middle.
+static int const wideEntrance = 6;
+
+static unsigned const noNode = UINT_MAX;
+
+typedef std::pair<int, unsigned> OpenEntry;
+typedef std::priority_queue<OpenEntry, std::vector<OpenEntry>,
+                            std::greater<OpenEntry> > OpenList;
+
+/**
+ * Estimates the cost of walking between two tiles, never overestimating it.
+ */
+static int estimateCost(const Point &a, const Point &b)
+{
+    const int dx = std::abs(a.x - b.x), dy = std::abs(a.y - b.y);
+    return std::abs(dx - dy) * basicCost + std::min(dx, dy) * diagonalCost;
+}
+
+/**
+ * Converts a cost to the maximum cost in tiles passed to Map::findPath.
+ */
+static int costInTiles(int cost)
+{
+    return (cost + basicCost - 1) / basicCost;
+}
+
+ClusterGraph::ClusterGraph(const Map *map, int clusterSize):
+    mMap(map),
+    mClusterSize(clusterSize),
+    mClustersX((map->getWidth() + clusterSize - 1) / clusterSize),
+    mClustersY((map->getHeight() + clusterSize - 1) / clusterSize),
+    mClusters(mClustersX * mClustersY),
+    mDirty(true),
+    mCosts(clusterSize * clusterSize),
+    mSearchStamp(0)
+{
+    for (int cy = 0; cy < mClustersY; ++cy)
+    {
+        for (int cx = 0; cx < mClustersX; ++cx)
+        {
+            Cluster &cluster = mClusters[cx + cy * mClustersX];
+            cluster.rightDirty = cx + 1 < mClustersX;
+            cluster.bottomDirty = cy + 1 < mClustersY;
+            cluster.edgesDirty = true;
+        }
+    }
+
+    repair();
+}
+
+void ClusterGraph::tileChanged(int x, int y)
+{
+    const int cx = x / mClusterSize;
+    const int cy = y / mClusterSize;
+    const unsigned index = cx + cy * mClustersX;
+
+    // Entrances only depend on the tiles along the borders.
+    if (x % mClusterSize == 0 && cx > 0)
+        mClusters[index - 1].rightDirty = true;
+    if ((x + 1) % mClusterSize == 0 && cx + 1 < mClustersX)
+        mClusters[index].rightDirty = true;
+    if (y % mClusterSize == 0 && cy > 0)
+        mClusters[index - mClustersX].bottomDirty = true;
+    if ((y + 1) % mClusterSize == 0 && cy + 1 < mClustersY)
+        mClusters[index].bottomDirty = true;
+
+    mClusters[index].edgesDirty = true;
+    mDirty = true;
+}
+
+/**
+ * Rebuilds the entrances and edges marked by tileChanged.
+ */
+void ClusterGraph::repair()
+{
+    if (!mDirty)
+        return;
+
+    for (unsigned i = 0, end = mClusters.size(); i < end; ++i)
+    {
+        Cluster &cluster = mClusters[i];
+        if (cluster.rightDirty)
+        {
+            rebuildEntrances(i, i + 1);
+            cluster.rightDirty = false;
+        }
+        if (cluster.bottomDirty)
+        {
+            rebuildEntrances(i, i + mClustersX);
+            cluster.bottomDirty = false;
+        }
+    }
+
+    for (unsigned i = 0, end = mClusters.size(); i < end; ++i)
+    {
+        Cluster &cluster = mClusters[i];
+        if (cluster.edgesDirty)
+        {
+            connectNodes(i);
+            cluster.edgesDirty = false;
+        }
+    }
+
+    mDirty = false;
+}
+
+/**
+ * Replaces the entrances between a cluster and its neighbour to the right or
+ * below. An entrance is a run of tiles along the border that are walkable on
+ * both sides.
+ */
+void ClusterGraph::rebuildEntrances(unsigned first, unsigned second)
+{
+    std::vector<unsigned> removed;
+    const std::vector<unsigned> &nodes = mClusters[first].nodes;
+    for (unsigned i = 0, end = nodes.size(); i < end; ++i)
+    {
+        const unsigned partner = mNodes[nodes[i]].partner;
+        if (mNodes[partner].cluster == second)
+        {
+            removed.push_back(nodes[i]);
+            removed.push_back(partner);
+        }
+    }
+    for (unsigned i = 0, end = removed.size(); i < end; ++i)
+        removeNode(removed[i]);
+
+    mClusters[first].edgesDirty = true;
+    mClusters[second].edgesDirty = true;
+
+    // Walk along the border on the side of the first cluster
+    const bool toTheRight = second == first + 1;
+    const int dx = toTheRight ? 1 : 0;
+    const int dy = toTheRight ? 0 : 1;
+    const int cx = first % mClustersX;
+    const int cy = first / mClustersX;
+    const Point origin(toTheRight ? (cx + 1) * mClusterSize - 1
+                                  : cx * mClusterSize,
+                       toTheRight ? cy * mClusterSize
+                                  : (cy + 1) * mClusterSize - 1);
+    const int length = toTheRight
+            ? std::min(mClusterSize, mMap->getHeight() - origin.y)
+            : std::min(mClusterSize, mMap->getWidth() - origin.x);
+
+    int runStart = -1;
+    for (int i = 0; i <= length; ++i)
+    {
+        const int x = origin.x + i * dy;
+        const int y = origin.y + i * dx;
+
+        if (i < length && walkable(x, y) && walkable(x + dx, y + dy))
+        {
+            if (runStart < 0)
+                runStart = i;
+            continue;
+        }
+
+        if (runStart < 0)
+            continue;
+
+        const int runEnd = i - 1;
+        if (runEnd - runStart + 1 >= wideEntrance)
+        {
+            addEntrance(first, second, Point(origin.x + runStart * dy,
+                                             origin.y + runStart * dx),
+                        dx, dy);
+            addEntrance(first, second, Point(origin.x + runEnd * dy,
+                                             origin.y + runEnd * dx),
+                        dx, dy);
+        }
+        else
+        {
+            const int middle = (runStart + runEnd) / 2;
+            addEntrance(first, second, Point(origin.x + middle * dy,
+                                             origin.y + middle * dx),
+                        dx, dy);
+        }
+        runStart = -1;
+    }
+}
+
+void ClusterGraph::addEntrance(unsigned first, unsigned second,
+                               const Point &tile, int dx, int dy)
+{
+    const unsigned a = addNode(first, tile);
+    const unsigned b = addNode(second, Point(tile.x + dx, tile.y + dy));
+    mNodes[a].partner = b;
+    mNodes[b].partner = a;
+}
+
+unsigned ClusterGraph::addNode(unsigned cluster, const Point &tile)
+{
+    unsigned node;
+    if (mFreeNodes.empty())
+    {
+        node = mNodes.size();
+        mNodes.push_back(Node());
+    }
+    else
+    {
+        node = mFreeNodes.back();
+        mFreeNodes.pop_back();
+    }
+
+    mNodes[node].tile = tile;
+    mNodes[node].cluster = cluster;
+    mNodes[node].partner = noNode;
+    mClusters[cluster].nodes.push_back(node);
+    return node;
+}
+
+/**
+ * Removes a node from its cluster. The edges of the other nodes of the
+ * cluster still lead to it until the cluster gets connected again.
+ */
+void ClusterGraph::removeNode(unsigned node)
+{
+    std::vector<unsigned> &nodes = mClusters[mNodes[node].cluster].nodes;
+    nodes.erase(std::find(nodes.begin(), nodes.end(), node));
+    mNodes[node].edges.clear();
+    mNodes[node].partner = noNode;
+    mFreeNodes.push_back(node);
+}
+
+/**
+ * Links the nodes of a cluster with the cost of walking between them.
+ */
+void ClusterGraph::connectNodes(unsigned cluster)
+{
+    const std::vector<unsigned> &nodes = mClusters[cluster].nodes;
+    for (unsigned i = 0, end = nodes.size(); i < end; ++i)
+        mNodes[nodes[i]].edges.clear();
+
+    for (unsigned i = 0, end = nodes.size(); i < end; ++i)
+    {
+        Node &node = mNodes[nodes[i]];
+        searchCluster(cluster, node.tile);
+
+        for (unsigned j = i + 1; j < end; ++j)
+        {
+            Node &other = mNodes[nodes[j]];
+            const int cost = costTo(other.tile);
+            if (cost == INT_MAX)
+                continue;
+
+            node.edges.push_back(Edge(nodes[j], cost));
+            other.edges.push_back(Edge(nodes[i], cost));
+        }
+    }
+}
+
+/**
+ * Finds the cost of walking from the given tile to each tile of a cluster,
+ * without leaving it. The results are read with costTo.
+ */
+void ClusterGraph::searchCluster(unsigned cluster, const Point &from)
+{
+    const int x0 = cluster % mClustersX * mClusterSize;
+    const int y0 = cluster / mClustersX * mClusterSize;
+    const int x1 = std::min(x0 + mClusterSize, mMap->getWidth());
+    const int y1 = std::min(y0 + mClusterSize, mMap->getHeight());
+
+    mCostsOrigin = Point(x0, y0);
+    std::fill(mCosts.begin(), mCosts.end(), INT_MAX);
+
+    OpenList openList;
+    const unsigned start = (from.x - x0) + (from.y - y0) * mClusterSize;
+    mCosts[start] = 0;
+    openList.push(OpenEntry(0, start));
+
+    while (!openList.empty())
+    {
+        const OpenEntry curr = openList.top();
+        openList.pop();
+        if (curr.first > mCosts[curr.second])
+            continue;
+
+        const int currX = x0 + curr.second % mClusterSize;
+        const int currY = y0 + curr.second / mClusterSize;
+
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                const int x = currX + dx;
+                const int y = currY + dy;
+
+                if ((dx == 0 && dy == 0) || x < x0 || y < y0 ||
+                    x >= x1 || y >= y1 || !walkable(x, y))
+                    continue;
+
+                // Same rule as the path finder for cutting corners
+                if (dx != 0 && dy != 0 &&
+                    (!walkable(currX, y) || !walkable(x, currY)))
+                    continue;
+
+                const int cost = curr.first +
+                        (dx == 0 || dy == 0 ? straightCost : diagonalCost);
+                const unsigned index = (x - x0) + (y - y0) * mClusterSize;
+                if (cost < mCosts[index])
+                {
+                    mCosts[index] = cost;
+                    openList.push(OpenEntry(cost, index));
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Returns the cost to a tile of the cluster last searched, or INT_MAX when it
+ * cannot be reached.
+ */
+int ClusterGraph::costTo(const Point &tile) const
+{
+    return mCosts[(tile.x - mCostsOrigin.x) +
+                  (tile.y - mCostsOrigin.y) * mClusterSize];
+}
+
+ClusterGraph::SearchInfo &ClusterGraph::getSearchInfo(unsigned node)
+{
+    SearchInfo &info = mSearchInfos[node];
+    if (info.stamp != mSearchStamp)
+    {
+        info.stamp = mSearchStamp;
+        info.Gcost = INT_MAX;
+        info.destCost = INT_MAX;
+        info.parent = noNode;
+        info.closed = false;
+    }
+    return info;
+}
+
+Route ClusterGraph::findRoute(int startX, int startY, int destX, int destY)
+{
+    Route route;
+
+    if (!walkable(startX, startY) || !walkable(destX, destY))
+        return route;
+
+    repair();
+
+    // A new stamp invalidates the search state of all the nodes
+    if (++mSearchStamp == 0)
+    {
+        for (unsigned i = 0, end = mSearchInfos.size(); i < end; ++i)
+            mSearchInfos[i].stamp = 0;
+        mSearchStamp = 1;
+    }
+    mSearchInfos.resize(mNodes.size());
+
+    const Point start(startX, startY);
+    const Point dest(destX, destY);
+    const unsigned startCluster = clusterAt(startX, startY);
+    const unsigned destCluster = clusterAt(destX, destY);
+
+    // Costs are the same both ways, so searching from the destination gives
+    // the cost of leaving the graph at each node of its cluster.
+    searchCluster(destCluster, dest);
+    const std::vector<unsigned> &destNodes = mClusters[destCluster].nodes;
+    for (unsigned i = 0, end = destNodes.size(); i < end; ++i)
+    {
+        const unsigned node = destNodes[i];
+        getSearchInfo(node).destCost = costTo(mNodes[node].tile);
+    }
+
+    searchCluster(startCluster, start);
+
+    int bestCost = INT_MAX;
+    unsigned bestNode = noNode;
+    if (startCluster == destCluster)
+        bestCost = costTo(dest);
+
+    OpenList openList;
+    const std::vector<unsigned> &startNodes = mClusters[startCluster].nodes;
+    for (unsigned i = 0, end = startNodes.size(); i < end; ++i)
+    {
+        const unsigned node = startNodes[i];
+        const int cost = costTo(mNodes[node].tile);
+        if (cost == INT_MAX)
+            continue;
+
+        getSearchInfo(node).Gcost = cost;
+        openList.push(OpenEntry(cost + estimateCost(mNodes[node].tile, dest),
+                                node));
+    }
+
+    while (!openList.empty())
+    {
+        const OpenEntry curr = openList.top();
+        openList.pop();
+
+        // No remaining node can lead to a cheaper route
+        if (curr.first >= bestCost)
+            break;
+
+        SearchInfo &info = getSearchInfo(curr.second);
+        if (info.closed)
+            continue;
+        info.closed = true;
+
+        if (info.destCost != INT_MAX && info.Gcost + info.destCost < bestCost)
+        {
+            bestCost = info.Gcost + info.destCost;
+            bestNode = curr.second;
+        }
+
+        const Node &node = mNodes[curr.second];
+        for (int i = -1, end = node.edges.size(); i < end; ++i)
+        {
+            // The first neighbour is the other side of the entrance
+            const unsigned next = i < 0 ? node.partner : node.edges[i].node;
+            const int cost = info.Gcost +
+                    (i < 0 ? straightCost : node.edges[i].cost);
+
+            SearchInfo &nextInfo = getSearchInfo(next);
+            if (nextInfo.closed || cost >= nextInfo.Gcost)
+                continue;
+
+            nextInfo.Gcost = cost;
+            nextInfo.parent = curr.second;
+            openList.push(OpenEntry(cost + estimateCost(mNodes[next].tile,
+                                                        dest),
+                                    next));
+        }
+    }
+
+    if (bestCost == INT_MAX)
+        return route;
+
+    // Walk back from the destination, keeping the nodes where the route
+    // enters a cluster.
+    route.push_front(Waypoint(dest, 0));
+    int nextCost = bestCost;
+    for (unsigned node = bestNode; node != noNode;
+         node = getSearchInfo(node).parent)
+    {
+        const SearchInfo &info = getSearchInfo(node);
+        if (info.parent == noNode || info.parent != mNodes[node].partner)
+            continue;
+
+        route.front().maxCost = costInTiles(nextCost - info.Gcost);
+        nextCost = info.Gcost;
+        route.push_front(Waypoint(mNodes[node].tile, 0));
+    }
+    route.front().maxCost = costInTiles(nextCost);
+
+    return route;
+}
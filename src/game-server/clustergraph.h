@@ -0,0 +1,164 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLUSTERGRAPH_H
+#define CLUSTERGRAPH_H
+
+#include "game-server/map.h"
+
+#include <vector>
+
+/**
+ * Graph used for hierarchical path planning (HPA*) over a whole map.
+ *
+ * The map is divided into square clusters. A node is put on both sides of
+ * each entrance between two neighbouring clusters, and the nodes of a cluster
+ * are linked with the cost of walking from one to the other without leaving
+ * it. A search through this graph gives the route between two distant tiles,
+ * and only the legs of the route, each within a cluster, need to be walked
+ * tile by tile.
+ *
+ * Only walls are taken into account, since the other beings move all the
+ * time. When walls are added or removed, the clusters around them are marked
+ * and repaired before the next search.
+ *
+ * A graph may only be used by one thread at a time.
+ */
+class ClusterGraph
+{
+    public:
+        /**
+         * Builds the graph of the given map, with clusters of the given size
+         * in tiles.
+         */
+        ClusterGraph(const Map *map, int clusterSize);
+
+        /**
+         * Returns the size of the clusters in tiles.
+         */
+        int getClusterSize() const
+        { return mClusterSize; }
+
+        /**
+         * Returns the number of nodes of the graph.
+         */
+        unsigned getNodeCount() const
+        { return mNodes.size() - mFreeNodes.size(); }
+
+        /**
+         * Marks the parts of the graph depending on the given tile for
+         * repair, after its walls changed.
+         */
+        void tileChanged(int x, int y);
+
+        /**
+         * Finds a route between two tiles. Its waypoints are the tiles where
+         * the route enters a cluster, followed by the destination. Returns an
+         * empty route when the destination cannot be reached.
+         */
+        Route findRoute(int startX, int startY, int destX, int destY);
+
+    private:
+        struct Edge
+        {
+            Edge(unsigned node, int cost):
+                node(node), cost(cost)
+            {}
+
+            unsigned node;
+            int cost;
+        };
+
+        struct Node
+        {
+            Point tile;
+            unsigned cluster;
+            unsigned partner;   /**< Node on the other side of the entrance. */
+            std::vector<Edge> edges;    /**< To nodes of the same cluster. */
+        };
+
+        struct Cluster
+        {
+            Cluster():
+                rightDirty(false),
+                bottomDirty(false),
+                edgesDirty(false)
+            {}
+
+            std::vector<unsigned> nodes;
+            bool rightDirty;    /**< Entrances to the right need a rebuild. */
+            bool bottomDirty;   /**< Entrances below need a rebuild. */
+            bool edgesDirty;    /**< Edges between the nodes need a rebuild. */
+        };
+
+        /**
+         * State of a node during a search. It is only valid when its stamp
+         * is the one of the current search.
+         */
+        struct SearchInfo
+        {
+            SearchInfo():
+                stamp(0), Gcost(0), destCost(0), parent(0), closed(false)
+            {}
+
+            unsigned stamp;
+            int Gcost;          /**< Cost from the start to this node. */
+            int destCost;       /**< Cost from this node to the destination. */
+            unsigned parent;
+            bool closed;
+        };
+
+        unsigned clusterAt(int x, int y) const
+        { return x / mClusterSize + y / mClusterSize * mClustersX; }
+
+        bool walkable(int x, int y) const
+        { return mMap->getWalk(x, y, Map::BLOCKMASK_WALL); }
+
+        void repair();
+        void rebuildEntrances(unsigned first, unsigned second);
+        void addEntrance(unsigned first, unsigned second,
+                         const Point &tile, int dx, int dy);
+        unsigned addNode(unsigned cluster, const Point &tile);
+        void removeNode(unsigned node);
+        void connectNodes(unsigned cluster);
+
+        void searchCluster(unsigned cluster, const Point &from);
+        int costTo(const Point &tile) const;
+
+        SearchInfo &getSearchInfo(unsigned node);
+
+        const Map *mMap;
+        int mClusterSize;
+        int mClustersX, mClustersY;
+
+        std::vector<Cluster> mClusters;
+        std::vector<Node> mNodes;
+        std::vector<unsigned> mFreeNodes;
+        bool mDirty;
+
+        /** Costs found by the last searchCluster, for each of its tiles. */
+        std::vector<int> mCosts;
+        Point mCostsOrigin;
+
+        std::vector<SearchInfo> mSearchInfos;
+        unsigned mSearchStamp;
+};
+
+#endif // CLUSTERGRAPH_H
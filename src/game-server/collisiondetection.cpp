@@ -20,6 +20,7 @@
 
 #include "game-server/collisiondetection.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include "utils/mathutils.h"
@@ -174,3 +175,85 @@ bool Collision::circleWithCircle(const Point &center1, int radius1,
 
     return distSquared < touchDistance * touchDistance;
 }
+
+/* Candidates are tested in blocks. The first loop over a block only computes
+   whether each candidate is a hit, so that the compiler can vectorize it. The
+   second one gathers the indices of the hits without branching. */
+static const unsigned blockSize = 64;
+
+template <typename Test>
+static unsigned selectHits(unsigned count, const Test &test, unsigned *hits)
+{
+    unsigned char isHit[blockSize];
+    unsigned nbHits = 0;
+
+    for (unsigned begin = 0; begin < count; begin += blockSize)
+    {
+        const unsigned size = std::min(blockSize, count - begin);
+
+        for (unsigned i = 0; i < size; ++i)
+            isHit[i] = test(begin + i);
+
+        for (unsigned i = 0; i < size; ++i)
+        {
+            hits[nbHits] = begin + i;
+            nbHits += isHit[i];
+        }
+    }
+
+    return nbHits;
+}
+
+unsigned Collision::circlesWithCircle(const int *x, const int *y,
+                                      const int *radius, unsigned count,
+                                      const Point &center, int circleRadius,
+                                      unsigned *hits)
+{
+    const int centerX = center.x, centerY = center.y;
+    return selectHits(count, [=](unsigned i) {
+        const int touchDistance = radius[i] + circleRadius;
+        const int distX = x[i] - centerX;
+        const int distY = y[i] - centerY;
+        return distX * distX + distY * distY < touchDistance * touchDistance;
+    }, hits);
+}
+
+unsigned Collision::pointsInRectangle(const int *x, const int *y,
+                                      unsigned count,
+                                      const Rectangle &rectangle,
+                                      unsigned *hits)
+{
+    const int x1 = rectangle.x, x2 = rectangle.x + rectangle.w;
+    const int y1 = rectangle.y, y2 = rectangle.y + rectangle.h;
+    return selectHits(count, [=](unsigned i) {
+        return (x[i] >= x1) & (x[i] < x2) & (y[i] >= y1) & (y[i] < y2);
+    }, hits);
+}
+
+unsigned Collision::disksWithCircleSector(const int *x, const int *y,
+                                          const int *radius, unsigned count,
+                                          const Point &sectorCenter,
+                                          int sectorRadius,
+                                          int halfTopAngle, int placeAngle,
+                                          unsigned *hits)
+{
+    // Only the disks touching the whole circle may touch the sector
+    const int centerX = sectorCenter.x, centerY = sectorCenter.y;
+    const unsigned nbNear = selectHits(count, [=](unsigned i) {
+        const int touchDistance = radius[i] + sectorRadius;
+        const int distX = x[i] - centerX;
+        const int distY = y[i] - centerY;
+        return distX * distX + distY * distY <= touchDistance * touchDistance;
+    }, hits);
+
+    unsigned nbHits = 0;
+    for (unsigned i = 0; i < nbNear; ++i)
+    {
+        const unsigned index = hits[i];
+        if (diskWithCircleSector(Point(x[index], y[index]), radius[index],
+                                 sectorCenter, sectorRadius,
+                                 halfTopAngle, placeAngle))
+            hits[nbHits++] = index;
+    }
+    return nbHits;
+}
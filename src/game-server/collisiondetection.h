@@ -22,6 +22,7 @@
 #define COLLISIONDETECTION_H
 
 class Point;
+class Rectangle;
 
 /**
  * This namespace collects all needed collision detection functions
@@ -50,6 +51,34 @@ namespace Collision
      */
     bool circleWithCircle(const Point &center1, int radius1,
                           const Point &center2, int radius2);
+
+    /**
+     * Checks which of the given circles intersect a circle, like
+     * circleWithCircle. The indices of those that do are written to
+     * \a hits, which needs room for all of them, and their number is
+     * returned.
+     */
+    unsigned circlesWithCircle(const int *x, const int *y, const int *radius,
+                               unsigned count,
+                               const Point &center, int circleRadius,
+                               unsigned *hits);
+
+    /**
+     * Checks which of the given points are inside a rectangle, like
+     * Rectangle::contains. Hits are returned like with circlesWithCircle.
+     */
+    unsigned pointsInRectangle(const int *x, const int *y, unsigned count,
+                               const Rectangle &rectangle, unsigned *hits);
+
+    /**
+     * Checks which of the given disks collide with a circle sector, like
+     * diskWithCircleSector. Hits are returned like with circlesWithCircle.
+     */
+    unsigned disksWithCircleSector(const int *x, const int *y,
+                                   const int *radius, unsigned count,
+                                   const Point &sectorCenter, int sectorRadius,
+                                   int halfTopAngle, int placeAngle,
+                                   unsigned *hits);
 }
 
 #endif
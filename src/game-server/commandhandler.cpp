@@ -833,8 +833,12 @@ static void handleRecall(Entity *player, std::string &args)
     GameState::warp(other, map, pos);
 }
 
-static void handleReload(Entity *, std::string &)
+static void handleReload(Entity *player, std::string &)
 {
+    // reload the server options
+    if (!Configuration::reload())
+        say("Unable to read the configuration file.", player);
+
     // reload the items and monsters
     itemManager->reload();
     monsterManager->reload();
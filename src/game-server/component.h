@@ -21,6 +21,11 @@
 #ifndef COMPONENT_H
 #define COMPONENT_H
 
+#include "utils/memorypool.h"
+
+#include <cassert>
+#include <cstddef>
+
 #include <sigc++/trackable.h>
 
 class Entity;
@@ -60,4 +65,37 @@ public:
     virtual void update(Entity &entity) = 0;
 };
 
+/**
+ * A component of which there are many, allocated from a pool for its type so
+ * that the components updated together are close in memory.
+ *
+ * Pooled components may only be created and deleted on the main thread.
+ */
+template <class T>
+class PooledComponent : public Component
+{
+public:
+    static void *operator new(std::size_t size)
+    {
+        assert(size == sizeof(T));
+        return getPool().allocate();
+    }
+
+    static void operator delete(void *component)
+    {
+        getPool().deallocate(component);
+    }
+
+private:
+    /**
+     * The pool is never destroyed, as components may still be deleted while
+     * static objects are destroyed.
+     */
+    static utils::MemoryPool &getPool()
+    {
+        static utils::MemoryPool *pool = new utils::MemoryPool(sizeof(T));
+        return *pool;
+    }
+};
+
 #endif // COMPONENT_H
@@ -29,7 +29,7 @@ class Entity;
 class MapComposite;
 class Point;
 
-class EffectComponent : public Component
+class EffectComponent : public PooledComponent<EffectComponent>
 {
     public:
         static const ComponentType type = CT_Effect;
@@ -53,6 +53,7 @@ class Entity : public sigc::trackable
         EntityType getType() const;
 
         template <class T> void addComponent(T *component);
+        Component *getComponent(ComponentType type) const;
         template <class T> T *getComponent() const;
         template <class T> T *findComponent() const;
         template <class T> bool hasComponent() const;
@@ -71,8 +72,6 @@ class Entity : public sigc::trackable
         sigc::signal<void, Entity *> signal_map_changed;
 
     private:
-        Component *getComponent(ComponentType type) const;
-
         unsigned mId;
         MapComposite *mMap;     /**< Map the entity is on */
         EntityType mType;       /**< Type of this entity. */
@@ -0,0 +1,254 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/flowfield.h"
+
+#include "common/configuration.h"
+#include "game-server/state.h"
+
+#include <algorithm>
+#include <climits>
+
+// Step costs, the same as the ones of Map::findPath.
+static int const basicCost = 100;
+static int const diagonalCost = basicCost * 362 / 256;
+static int const straightCost = basicCost + 1;
+
+// Maximum number of destinations followed per map.
+static unsigned const maxFields = 32;
+
+/**
+ * Number of beings looking for a path to the same tile during a tick from
+ * which they share a field, or 0 to never share them.
+ */
+static Configuration::IntOption flowFieldBeingsOption("game_flowFieldBeings",
+                                                      2);
+
+FlowFields::FlowFields(const Map *map):
+    mMap(map)
+{
+}
+
+bool FlowFields::findPath(int startX, int startY,
+                          int destX, int destY,
+                          unsigned char walkmask, int maxCost,
+                          Path &path)
+{
+    const int threshold = flowFieldBeingsOption;
+    if (threshold <= 0)
+        return false;
+
+    const int tick = GameState::getCurrentTick();
+    Field *field = getField(Point(destX, destY), walkmask, maxCost, tick);
+
+    if (field->computedTick != tick)
+    {
+        if (field->requestTick != tick)
+        {
+            field->requestTick = tick;
+            field->requests = 0;
+        }
+        if (++field->requests < threshold)
+            return false;
+
+        compute(*field);
+    }
+
+    path.clear();
+    if (startX == destX && startY == destY)
+        return true;
+
+    // Beings moving in the way since the field was computed, or a start out
+    // of its reach, are left to the search of the caller
+    return followField(*field, startX, startY, path);
+}
+
+/**
+ * Returns the field for the given destination, making room for it when there
+ * is none yet.
+ */
+FlowFields::Field *FlowFields::getField(const Point &target,
+                                        unsigned char walkmask, int maxCost,
+                                        int tick)
+{
+    Field *oldest = nullptr;
+    for (std::vector<Field>::iterator it = mFields.begin(),
+         it_end = mFields.end(); it != it_end; ++it)
+    {
+        if (it->target == target && it->walkmask == walkmask &&
+            it->maxCost == maxCost)
+            return &*it;
+
+        if (!oldest || it->requestTick < oldest->requestTick)
+            oldest = &*it;
+    }
+
+    // Fields of destinations nobody asked for during the last tick are
+    // replaced first.
+    const bool oldestInUse = oldest && oldest->requestTick >= tick - 1;
+    if (mFields.size() < maxFields && (!oldest || oldestInUse))
+    {
+        mFields.push_back(Field());
+        oldest = &mFields.back();
+    }
+
+    oldest->target = target;
+    oldest->walkmask = walkmask;
+    oldest->maxCost = maxCost;
+    oldest->requestTick = -1;
+    oldest->requests = 0;
+    oldest->computedTick = -1;
+    return oldest;
+}
+
+/**
+ * Computes the cost of walking from each tile within reach to the destination
+ * of the field.
+ */
+void FlowFields::compute(Field &field)
+{
+    const int maxTiles = field.maxCost;
+    field.origin = Point(field.target.x - maxTiles, field.target.y - maxTiles);
+    field.size = 2 * maxTiles + 1;
+    field.costs.assign(field.size * field.size, INT_MAX);
+    field.computedTick = GameState::getCurrentTick();
+
+    if (!mMap->getWalk(field.target.x, field.target.y, field.walkmask))
+        return;
+
+    const int budget = field.maxCost * basicCost;
+    const int targetIndex = maxTiles + maxTiles * field.size;
+    field.costs[targetIndex] = 0;
+    mOpenList.push(OpenEntry(0, targetIndex));
+
+    while (!mOpenList.empty())
+    {
+        const OpenEntry curr = mOpenList.top();
+        mOpenList.pop();
+        if (curr.first > field.costs[curr.second])
+            continue;
+
+        const int currX = field.origin.x + curr.second % field.size;
+        const int currY = field.origin.y + curr.second / field.size;
+
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                const int x = currX + dx;
+                const int y = currY + dy;
+
+                if ((dx == 0 && dy == 0) ||
+                    !mMap->getWalk(x, y, field.walkmask))
+                    continue;
+
+                // Same rule as the path finder for cutting corners
+                if (dx != 0 && dy != 0 &&
+                    (!mMap->getWalk(currX, y, field.walkmask) ||
+                     !mMap->getWalk(x, currY, field.walkmask)))
+                    continue;
+
+                const int cost = curr.first +
+                        (dx == 0 || dy == 0 ? straightCost : diagonalCost);
+
+                // The budget also keeps the search within the field
+                if (cost > budget)
+                    continue;
+
+                const int index = (x - field.origin.x) +
+                                  (y - field.origin.y) * field.size;
+                if (cost < field.costs[index])
+                {
+                    field.costs[index] = cost;
+                    mOpenList.push(OpenEntry(cost, index));
+                }
+            }
+        }
+    }
+}
+
+int FlowFields::costAt(const Field &field, int x, int y) const
+{
+    x -= field.origin.x;
+    y -= field.origin.y;
+    if (x < 0 || y < 0 || x >= field.size || y >= field.size)
+        return INT_MAX;
+    return field.costs[x + y * field.size];
+}
+
+/**
+ * Builds the path from the given tile by always stepping to the neighbour
+ * closest to the destination. The start itself does not need to be walkable,
+ * like with Map::findPath.
+ */
+bool FlowFields::followField(const Field &field, int startX, int startY,
+                             Path &path) const
+{
+    int x = startX, y = startY;
+    int cost = INT_MAX;
+
+    while (x != field.target.x || y != field.target.y)
+    {
+        int bestX = 0, bestY = 0, bestCost = INT_MAX;
+
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                // Beings may have moved since the field was computed, so
+                // the path is kept to the tiles walkable now.
+                const int remaining = costAt(field, x + dx, y + dy);
+                if ((dx == 0 && dy == 0) || remaining == INT_MAX ||
+                    !mMap->getWalk(x + dx, y + dy, field.walkmask))
+                    continue;
+
+                if (dx != 0 && dy != 0 &&
+                    (!mMap->getWalk(x, y + dy, field.walkmask) ||
+                     !mMap->getWalk(x + dx, y, field.walkmask)))
+                    continue;
+
+                const int total = remaining +
+                        (dx == 0 || dy == 0 ? straightCost : diagonalCost);
+                if (total < bestCost)
+                {
+                    bestX = x + dx;
+                    bestY = y + dy;
+                    bestCost = total;
+                }
+            }
+        }
+
+        // The cost has to go down at each step, and the whole path has to
+        // stay within the budget.
+        if (bestCost == INT_MAX || bestCost > field.maxCost * basicCost ||
+            (cost != INT_MAX && bestCost > cost))
+        {
+            path.clear();
+            return false;
+        }
+
+        cost = costAt(field, bestX, bestY);
+        x = bestX;
+        y = bestY;
+        path.push_back(Point(x, y));
+    }
+
+    return true;
+}
@@ -0,0 +1,98 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include "game-server/map.h"
+
+#include <queue>
+#include <vector>
+
+/**
+ * Paths shared by the beings of a map walking to the same tile, like a pack
+ * of monsters chasing a character.
+ *
+ * Once enough beings look for a path to the same tile during a tick, the cost
+ * of walking to that tile is computed for every tile around it, once. Each of
+ * them then finds its path by going downhill in this field, instead of doing
+ * its own search. The paths cost the same as the ones of Map::findPath.
+ *
+ * A field takes the blocking beings into account, so it is only used during
+ * the tick it was computed in. Since fields are kept by destination tile, a
+ * target moving to another tile gets a new field.
+ *
+ * The fields of a map may only be used by one thread at a time.
+ */
+class FlowFields
+{
+    public:
+        FlowFields(const Map *map);
+
+        /**
+         * Finds a path with the same arguments as Map::findPath, when there
+         * is a field for the destination. Returns false when the destination
+         * is not popular enough for a field yet, or when no path could be
+         * followed in the field, in which case the caller should look for
+         * the path itself.
+         */
+        bool findPath(int startX, int startY,
+                      int destX, int destY,
+                      unsigned char walkmask, int maxCost,
+                      Path &path);
+
+    private:
+        struct Field
+        {
+            Field():
+                walkmask(0),
+                maxCost(0),
+                requestTick(-1),
+                requests(0),
+                computedTick(-1)
+            {}
+
+            Point target;
+            unsigned char walkmask;
+            int maxCost;
+            int requestTick;    /**< Tick in which requests were counted. */
+            int requests;       /**< Number of requests during that tick. */
+            int computedTick;   /**< Tick in which the costs were computed. */
+            Point origin;       /**< Top left tile of the costs. */
+            int size;           /**< Width and height of the costs. */
+            std::vector<int> costs;
+        };
+
+        Field *getField(const Point &target, unsigned char walkmask,
+                        int maxCost, int tick);
+        void compute(Field &field);
+        int costAt(const Field &field, int x, int y) const;
+        bool followField(const Field &field, int startX, int startY,
+                         Path &path) const;
+
+        const Map *mMap;
+        std::vector<Field> mFields;
+
+        typedef std::pair<int, int> OpenEntry;
+        std::priority_queue<OpenEntry, std::vector<OpenEntry>,
+                            std::greater<OpenEntry> > mOpenList;
+};
+
+#endif // FLOWFIELD_H
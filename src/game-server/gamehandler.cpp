@@ -46,6 +46,20 @@
 
 const unsigned TILES_TO_BE_NEAR = 7;
 
+/**
+ * Whether the messages to a client during a tick are sent as a single bundle,
+ * for the clients that support it.
+ */
+static Configuration::BoolOption bundleMessagesOption("net_bundleMessages",
+                                                      false);
+
+/**
+ * Whether the movements of the beings are sent as changes since the last
+ * update acknowledged by a client, for the clients that support it.
+ */
+static Configuration::BoolOption movementDeltasOption("net_movementDeltas",
+                                                      false);
+
 GameHandler::GameHandler():
     mTokenCollector(this)
 {
@@ -57,6 +71,17 @@ bool GameHandler::startListen(enet_uint16 port)
     return ConnectionHandler::startListen(port);
 }
 
+void GameHandler::flush()
+{
+    for (NetComputers::const_iterator i = clients.begin(),
+         i_end = clients.end(); i != i_end; ++i)
+    {
+        (*i)->flushBundle();
+    }
+
+    ConnectionHandler::flush();
+}
+
 NetComputer *GameHandler::computerConnected(ENetPeer *peer)
 {
     return new GameClient(peer);
@@ -132,7 +157,7 @@ void GameHandler::updateCharacter(int charid, int partyid)
                 c->character->getComponent<CharacterComponent>();
 
         if (characterComponent->getDatabaseID() == charid)
-            characterComponent->setParty(partyid);
+            characterComponent->setParty(*c->character, partyid);
     }
 }
 
@@ -181,6 +206,13 @@ void GameHandler::processMessage(NetComputer *computer, MessageIn &message)
             return;
 
         std::string magic_token = message.readString(MAGIC_TOKEN_LENGTH);
+
+        // Older clients do not send their version
+        if (message.getUnreadLength() > 0)
+            client.version = message.readInt32();
+        client.setBundling(bundleMessagesOption &&
+                           client.version >= MIN_BUNDLE_PROTOCOL_VERSION);
+
         client.status = CLIENT_QUEUED; // Before the addPendingClient
         mTokenCollector.addPendingClient(magic_token, &client);
         return;
@@ -294,6 +326,10 @@ void GameHandler::processMessage(NetComputer *computer, MessageIn &message)
             handleTriggerEmoticon(client, message);
             break;
 
+        case PGMSG_BEINGS_MOVE_ACK:
+            handleMovementAck(client, message);
+            break;
+
         default:
             LOG_WARN("Invalid message type");
             client.send(MessageOut(XXMSG_INVALID));
@@ -301,17 +337,59 @@ void GameHandler::processMessage(NetComputer *computer, MessageIn &message)
     }
 }
 
-void GameHandler::sendTo(Entity *beingPtr, MessageOut &msg)
+void GameHandler::sendTo(Entity *beingPtr, MessageOut &msg, bool reliable)
 {
     GameClient *client = beingPtr->getComponent<CharacterComponent>()
             ->getClient();
-    sendTo(client, msg);
+    sendTo(client, msg, reliable);
 }
 
-void GameHandler::sendTo(GameClient *client, MessageOut &msg)
+/**
+ * Queue the messages of the current thread are redirected to, if any.
+ */
+static thread_local DeferredMessages *deferredMessages = nullptr;
+
+void GameHandler::sendTo(GameClient *client, MessageOut &msg, bool reliable)
 {
     assert(client && client->status == CLIENT_CONNECTED);
-    client->send(msg);
+    if (deferredMessages)
+        deferredMessages->add(client, msg, reliable);
+    else
+        client->send(msg, reliable);
+}
+
+void GameHandler::deferMessages(DeferredMessages *messages)
+{
+    deferredMessages = messages;
+}
+
+void DeferredMessages::add(GameClient *client, const MessageOut &msg,
+                           bool reliable)
+{
+    Message message;
+    message.client = client;
+    message.offset = mData.size();
+    message.reliable = reliable;
+
+    if (client->usesCompactEncoding())
+        msg.encodeCompact(mData);
+    else
+        mData.insert(mData.end(), msg.getData(),
+                     msg.getData() + msg.getLength());
+
+    message.length = mData.size() - message.offset;
+    mMessages.push_back(message);
+}
+
+void DeferredMessages::send()
+{
+    for (std::vector<Message>::const_iterator it = mMessages.begin(),
+         it_end = mMessages.end(); it != it_end; ++it)
+    {
+        it->client->send(&mData[it->offset], it->length, it->reliable);
+    }
+    mMessages.clear();
+    mData.clear();
 }
 
 void GameHandler::addPendingCharacter(const std::string &token, Entity *ch)
@@ -381,7 +459,28 @@ void GameHandler::tokenMatched(GameClient *computer, Entity *character)
     characterComponent->triggerLoginCallback(*character);
 
     result.writeInt8(ERRMSG_OK);
-    computer->send(result);
+
+    // The messages after this one are compact, when both sides support it
+    if (computer->version >= MIN_COMPACT_PROTOCOL_VERSION)
+    {
+        const bool compact = MessageOut::isCompactEncodingEnabled();
+        result.writeInt8(compact);
+
+        if (computer->version >= MIN_MOVEMENT_DELTA_PROTOCOL_VERSION)
+        {
+            const bool deltas = movementDeltasOption;
+            result.writeInt8(deltas);
+            if (deltas)
+                computer->movementSnapshots.reset(new MovementSnapshots);
+        }
+
+        computer->send(result);
+        computer->setCompactEncoding(compact);
+    }
+    else
+    {
+        computer->send(result);
+    }
 
     Inventory(character).sendFull();
     characterComponent->markAllInfoAsChanged(*character);
@@ -503,7 +602,7 @@ void GameHandler::handlePickup(GameClient &client, MessageIn &message)
 
                     // We only do this when items are to be kept in memory
                     // between two server restart.
-                    if (!Configuration::getValue("game_floorItemDecayTime", 0))
+                    if (!Item::floorItemDecayTimeOption.get())
                     {
                         // Remove the floor item from map
                         accountHandler->removeFloorItems(map->getID(),
@@ -578,7 +677,7 @@ void GameHandler::handleDrop(GameClient &client, MessageIn &message)
 
         // We store the item in database only when the floor items are meant
         // to be persistent between two server restarts.
-        if (!Configuration::getValue("game_floorItemDecayTime", 0))
+        if (!Item::floorItemDecayTimeOption.get())
         {
             // Create the floor item on map
             accountHandler->createFloorItems(client.character->getMap()->getID(),
@@ -935,7 +1034,7 @@ void GameHandler::handleNpcPostSend(GameClient &client, MessageIn &message)
 void GameHandler::handlePartyInvite(GameClient &client, MessageIn &message)
 {
     MapComposite *map = client.character->getMap();
-    const int visualRange = Configuration::getValue("game_visualRange", 448);
+    const int visualRange = GameState::visualRangeOption;
     std::string invitee = message.readString();
 
     if (invitee == client.character->getComponent<BeingComponent>()->getName())
@@ -980,6 +1079,13 @@ void GameHandler::handleTriggerEmoticon(GameClient &client, MessageIn &message)
                 *client.character, id);
 }
 
+void GameHandler::handleMovementAck(GameClient &client, MessageIn &message)
+{
+    const int sequence = message.readInt16();
+    if (client.movementSnapshots)
+        client.movementSnapshots->acknowledge(sequence);
+}
+
 void GameHandler::sendNpcError(GameClient &client, int id,
                                const std::string &errorMsg)
 {
@@ -21,10 +21,14 @@
 #ifndef SERVER_GAMEHANDLER_H
 #define SERVER_GAMEHANDLER_H
 
+#include "game-server/movementsnapshots.h"
 #include "net/connectionhandler.h"
 #include "net/netcomputer.h"
 #include "utils/tokencollector.h"
 
+#include <memory>
+#include <vector>
+
 class Entity;
 
 enum
@@ -38,9 +42,45 @@ enum
 struct GameClient: NetComputer
 {
     GameClient(ENetPeer *peer)
-      : NetComputer(peer), character(nullptr), status(CLIENT_LOGIN) {}
+      : NetComputer(peer), character(nullptr), status(CLIENT_LOGIN),
+        version(0) {}
     Entity *character;
     int status;
+    int version;        /**< Protocol version of the client, 0 if unknown. */
+
+    /** Null unless the client is sent movement deltas. */
+    std::unique_ptr<MovementSnapshots> movementSnapshots;
+};
+
+/**
+ * Messages to game clients that are held back and sent later, in the order
+ * they were added. Used while maps are updated concurrently, since the
+ * network layer may only be used from the main thread.
+ */
+class DeferredMessages
+{
+    public:
+        /**
+         * Adds a copy of a message for the given client.
+         */
+        void add(GameClient *client, const MessageOut &msg, bool reliable);
+
+        /**
+         * Sends the messages and empties the queue.
+         */
+        void send();
+
+    private:
+        struct Message
+        {
+            GameClient *client;
+            unsigned offset;    /**< Position of the data in mData. */
+            unsigned length;
+            bool reliable;
+        };
+
+        std::vector<Message> mMessages;
+        std::vector<char> mData;    /**< Data of all the messages. */
 };
 
 /**
@@ -56,11 +96,24 @@ class GameHandler: public ConnectionHandler
          */
         bool startListen(enet_uint16 port);
 
+        /**
+         * Sends the messages bundled for each client during the tick, then
+         * the queued packets.
+         */
+        void flush();
+
         /**
          * Sends message to the given character.
          */
-        void sendTo(Entity *, MessageOut &msg);
-        void sendTo(GameClient *, MessageOut &msg);
+        void sendTo(Entity *, MessageOut &msg, bool reliable = true);
+        void sendTo(GameClient *, MessageOut &msg, bool reliable = true);
+
+        /**
+         * Makes the messages sent through sendTo by the calling thread go to
+         * the given queue instead of the network. Passing null restores
+         * direct sending.
+         */
+        static void deferMessages(DeferredMessages *messages);
 
         /**
          * Kills connection with given character.
@@ -156,6 +209,8 @@ class GameHandler: public ConnectionHandler
 
         void handleTriggerEmoticon(GameClient &client, MessageIn &message);
 
+        void handleMovementAck(GameClient &client, MessageIn &message);
+
         void sendNpcError(GameClient &client, int id,
                           const std::string &errorMsg);
 
@@ -0,0 +1,144 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/gameserver.h"
+
+#include "common/configuration.h"
+#include "common/defines.h"
+#include "common/permissionmanager.h"
+#include "common/resourcemanager.h"
+#include "game-server/abilitymanager.h"
+#include "game-server/accountconnection.h"
+#include "game-server/asyncpathfinder.h"
+#include "game-server/attributemanager.h"
+#include "game-server/emotemanager.h"
+#include "game-server/gamehandler.h"
+#include "game-server/itemmanager.h"
+#include "game-server/mapmanager.h"
+#include "game-server/monstermanager.h"
+#include "game-server/postman.h"
+#include "game-server/settingsmanager.h"
+#include "game-server/state.h"
+#include "game-server/statusmanager.h"
+#include "net/bandwidth.h"
+#include "scripting/scriptmanager.h"
+#include "utils/logger.h"
+#include "utils/mathutils.h"
+#include "utils/processorutils.h"
+#include "utils/stringfilter.h"
+
+#include <physfs.h>
+
+using utils::Logger;
+
+#define DEFAULT_MAIN_SCRIPT_FILE            "scripts/main.lua"
+
+utils::StringFilter *stringFilter; /**< Slang's Filter */
+
+AbilityManager *abilityManager = new AbilityManager();
+AttributeManager *attributeManager = new AttributeManager();
+ItemManager *itemManager = new ItemManager();
+MonsterManager *monsterManager = new MonsterManager();
+EmoteManager *emoteManager = new EmoteManager();
+
+SettingsManager *settingsManager = new SettingsManager(DEFAULT_SETTINGS_FILE);
+
+/** Core game message handler */
+GameHandler *gameHandler;
+
+/** Account server message handler */
+AccountConnection *accountHandler;
+
+/** Post Man **/
+PostMan *postMan;
+
+/** Bandwidth Monitor */
+BandwidthMonitor *gBandwidth;
+
+void GameServer::initialize(const std::string &defaultLogFile)
+{
+    std::string logFile = Configuration::getValue("log_gameServerFile",
+                                                  defaultLogFile);
+
+    // Initialize PhysicsFS
+    PHYSFS_init("");
+
+    Logger::initialize(logFile);
+
+    // --- Initialize the managers
+    // Initialize the slang's and double quotes filter.
+    stringFilter = new utils::StringFilter;
+
+    ResourceManager::initialize();
+    ScriptManager::initialize();   // Depends on ResourceManager
+
+    // load game settings files
+    settingsManager->initialize();
+
+    PermissionManager::initialize(DEFAULT_PERMISSION_FILE);
+
+
+    std::string mainScript = Configuration::getValue("script_mainFile",
+                                                     DEFAULT_MAIN_SCRIPT_FILE);
+    ScriptManager::loadMainScript(mainScript);
+
+    // --- Initialize the global handlers
+    // FIXME: Make the global handlers global vars or part of a bigger
+    // singleton or a local variable in the event-loop
+    gameHandler = new GameHandler;
+    accountHandler = new AccountConnection;
+    postMan = new PostMan;
+    gBandwidth = new BandwidthMonitor;
+
+    // Pre-calculate the needed trigomic function values
+    utils::math::init();
+
+    // Initialize the processor utility functions
+    utils::processor::init();
+
+    // Start the threads updating the maps and searching for paths
+    GameState::initialize();
+    AsyncPathFinder::initialize();
+}
+
+void GameServer::deinitialize()
+{
+    // Write configuration file
+    Configuration::deinitialize();
+
+    // Destroy message handlers
+    delete gameHandler; gameHandler = 0;
+    delete accountHandler; accountHandler = 0;
+    delete postMan; postMan = 0;
+    delete gBandwidth; gBandwidth = 0;
+
+    // Destroy Managers
+    delete stringFilter; stringFilter = 0;
+    delete monsterManager; monsterManager = 0;
+    delete abilityManager; abilityManager = 0;
+    delete itemManager; itemManager = 0;
+    delete emoteManager; emoteManager = 0;
+    delete settingsManager; settingsManager = 0;
+    MapManager::deinitialize();
+    StatusManager::deinitialize();
+    ScriptManager::deinitialize();
+
+    PHYSFS_deinit();
+}
@@ -0,0 +1,47 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GAMESERVER_H
+#define GAMESERVER_H
+
+#include <string>
+
+/**
+ * The setup shared by the game server and the game tick benchmark: the
+ * global managers and handlers, and the world data they load.
+ */
+namespace GameServer
+{
+    /**
+     * Creates the managers and handlers and loads the world data. The
+     * configuration has to be initialized first. Leaves the network alone.
+     *
+     * @param defaultLogFile the log file used unless log_gameServerFile is
+     *                       set
+     */
+    void initialize(const std::string &defaultLogFile);
+
+    /**
+     * Destroys what initialize created.
+     */
+    void deinitialize();
+}
+
+#endif // GAMESERVER_H
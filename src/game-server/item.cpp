@@ -31,6 +31,9 @@
 #include <map>
 #include <string>
 
+Configuration::IntOption Item::floorItemDecayTimeOption(
+        "game_floorItemDecayTime", 0);
+
 bool ItemEffectAttrMod::apply(Entity *itemUser)
 {
     LOG_DEBUG("Applying modifier.");
@@ -135,7 +138,7 @@ ItemComponent::ItemComponent(ItemClass *type, int amount) :
     mType(type),
     mAmount(amount)
 {
-    mLifetime = Configuration::getValue("game_floorItemDecayTime", 0) * 10;
+    mLifetime = Item::floorItemDecayTimeOption * 10;
 }
 
 void ItemComponent::update(Entity &entity)
@@ -24,6 +24,7 @@
 
 #include <vector>
 
+#include "common/configuration.h"
 #include "game-server/actorcomponent.h"
 #include "scripting/script.h"
 
@@ -251,7 +252,7 @@ class ItemClass
 /**
  * An item stack lying on the floor in the game world.
  */
-class ItemComponent : public Component
+class ItemComponent : public PooledComponent<ItemComponent>
 {
     public:
         static const ComponentType type = CT_Item;
@@ -274,6 +275,12 @@ class ItemComponent : public Component
 
 namespace Item {
 
+/**
+ * Time in seconds after which the items dropped on the floor are removed, or
+ * 0 to keep them.
+ */
+extern Configuration::IntOption floorItemDecayTimeOption;
+
 /**
  * @brief Creates an item actor.
  *
@@ -0,0 +1,1426 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Headless benchmark of the game tick. Loads the world data, fills a map with
+ * simulated characters and monsters walking around, and runs the world
+ * update for a fixed number of ticks without any network or account server.
+ *
+ * With --check-encoding, it instead checks that messages read back the same
+ * from their regular and compact encodings, and that clients rebuild the
+ * movements sent as deltas.
+ */
+
+#include "common/configuration.h"
+#include "common/defines.h"
+#include "game-server/actorcomponent.h"
+#include "game-server/attributemanager.h"
+#include "game-server/being.h"
+#include "game-server/charactercomponent.h"
+#include "game-server/clustergraph.h"
+#include "game-server/gamehandler.h"
+#include "game-server/gameserver.h"
+#include "game-server/map.h"
+#include "game-server/mapcomposite.h"
+#include "game-server/mapmanager.h"
+#include "game-server/monster.h"
+#include "game-server/monstermanager.h"
+#include "game-server/movementsnapshots.h"
+#include "game-server/state.h"
+#include "game-server/statusmanager.h"
+#include "game-server/tickprofiler.h"
+#include "net/bandwidth.h"
+#include "net/messagein.h"
+#include "net/messageout.h"
+#include "scripting/scriptmanager.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <list>
+#include <map>
+#include <new>
+#include <sstream>
+#include <sigc++/trackable.h>
+#include <vector>
+
+using namespace ManaServ;
+using utils::Logger;
+
+#define DEFAULT_LOG_FILE                    "manaserv-game-bench.log"
+
+/** Number of allocations made since the start of the program */
+static std::atomic<unsigned long> allocationCount(0);
+
+void *operator new(std::size_t size)
+{
+    ++allocationCount;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+/**
+ * A being wandering around its starting point.
+ */
+struct Walker: sigc::trackable
+{
+    Walker(Entity *entity, const Point &home):
+        entity(entity),
+        home(home),
+        nextMove(0)
+    {}
+
+    void removed(Entity *)
+    { entity = nullptr; }
+
+    Entity *entity;     /**< Null once removed from the map. */
+    Point home;
+    int nextMove;       /**< Tick at which a new destination is chosen. */
+};
+
+typedef std::list<Walker> Walkers;
+
+struct CommandLineOptions
+{
+    CommandLineOptions():
+        verbosity(Logger::Error),
+        map("1"),
+        characters(100),
+        monsters(100),
+        monsterId(0),
+        ticks(1000),
+        warmup(100),
+        seed(1),
+        walkRadius(10),
+        zoneSize(0),
+        paths(200),
+        chase(false),
+        compact(false),
+        movementDeltas(false),
+        checkEncoding(false)
+    {}
+
+    std::string configPath;
+    Logger::Level verbosity;
+    std::string map;
+    int characters;
+    int monsters;
+    int monsterId;
+    int ticks;
+    int warmup;
+    unsigned seed;
+    int walkRadius;     /**< In tiles. */
+    int zoneSize;       /**< In pixels, 0 for the map's own choice. */
+    int paths;          /**< Number of path queries per algorithm. */
+    bool chase;         /**< Whether the monsters chase a character. */
+    bool compact;       /**< Whether the clients use compact messages. */
+    bool movementDeltas;    /**< Whether the clients get movement deltas. */
+    bool checkEncoding;     /**< Only checks the message encodings. */
+};
+
+/**
+ * Show command line arguments.
+ */
+static void printHelp()
+{
+    std::cout << "manaserv-game-bench" << std::endl << std::endl
+              << "Options: " << std::endl
+              << "  -h --help            : Display this help" << std::endl
+              << "     --config <path>   : Set the config path to use."
+              << " (Default: ./manaserv.xml)" << std::endl
+              << "  -v --verbosity <n>   : Set the verbosity level"
+              << " (Default: 1)" << std::endl
+              << "     --map <id|name>   : Map to simulate (Default: 1)"
+              << std::endl
+              << "     --characters <n>  : Number of characters (Default: 100)"
+              << std::endl
+              << "     --monsters <n>    : Number of monsters (Default: 100)"
+              << std::endl
+              << "     --monster-id <n>  : Monster species to spawn"
+              << " (Default: the first one)" << std::endl
+              << "     --ticks <n>       : Number of measured ticks"
+              << " (Default: 1000)" << std::endl
+              << "     --warmup <n>      : Ticks run before measuring"
+              << " (Default: 100)" << std::endl
+              << "     --seed <n>        : Random seed (Default: 1)"
+              << std::endl
+              << "     --radius <n>      : Walking radius in tiles"
+              << " (Default: 10)" << std::endl
+              << "     --zone-size <n>   : Size of the map zones in pixels"
+              << " (Default: as configured)" << std::endl
+              << "     --paths <n>       : Number of path queries per"
+              << " algorithm (Default: 200)" << std::endl
+              << "     --chase           : Monsters gather around the first"
+              << " character and chase it" << std::endl
+              << "     --compact         : Send compact messages to the"
+              << " characters" << std::endl
+              << "     --movement-deltas : Send movement deltas to the"
+              << " characters, acknowledged right away" << std::endl
+              << "     --check-encoding  : Check the compact encoding and"
+              << " the movement deltas, then exit" << std::endl;
+    exit(EXIT_NORMAL);
+}
+
+/**
+ * Parse the command line arguments
+ */
+static void parseOptions(int argc, char *argv[], CommandLineOptions &options)
+{
+    const char *optString = "hv:";
+
+    const struct option longOptions[] =
+    {
+        { "help",       no_argument,       0, 'h' },
+        { "config",     required_argument, 0, 'c' },
+        { "verbosity",  required_argument, 0, 'v' },
+        { "map",        required_argument, 0, 'm' },
+        { "characters", required_argument, 0, 'C' },
+        { "monsters",   required_argument, 0, 'M' },
+        { "monster-id", required_argument, 0, 'i' },
+        { "ticks",      required_argument, 0, 't' },
+        { "warmup",     required_argument, 0, 'w' },
+        { "seed",       required_argument, 0, 's' },
+        { "radius",     required_argument, 0, 'r' },
+        { "zone-size",  required_argument, 0, 'z' },
+        { "paths",      required_argument, 0, 'p' },
+        { "chase",      no_argument,       0, 'a' },
+        { "compact",    no_argument,       0, 'k' },
+        { "movement-deltas", no_argument,  0, 'd' },
+        { "check-encoding", no_argument,   0, 'e' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (optind < argc)
+    {
+        int result = getopt_long(argc, argv, optString, longOptions, nullptr);
+
+        if (result == -1)
+            break;
+
+        switch (result)
+        {
+            default: // Unknown option.
+            case 'h':
+                printHelp();
+                break;
+            case 'c':
+                options.configPath = optarg;
+                break;
+            case 'v':
+                options.verbosity = static_cast<Logger::Level>(atoi(optarg));
+                break;
+            case 'm':
+                options.map = optarg;
+                break;
+            case 'C':
+                options.characters = atoi(optarg);
+                break;
+            case 'M':
+                options.monsters = atoi(optarg);
+                break;
+            case 'i':
+                options.monsterId = atoi(optarg);
+                break;
+            case 't':
+                options.ticks = atoi(optarg);
+                break;
+            case 'w':
+                options.warmup = atoi(optarg);
+                break;
+            case 's':
+                options.seed = strtoul(optarg, nullptr, 10);
+                break;
+            case 'r':
+                options.walkRadius = atoi(optarg);
+                break;
+            case 'z':
+                options.zoneSize = atoi(optarg);
+                break;
+            case 'p':
+                options.paths = atoi(optarg);
+                break;
+            case 'a':
+                options.chase = true;
+                break;
+            case 'k':
+                options.compact = true;
+                break;
+            case 'd':
+                options.movementDeltas = true;
+                break;
+            case 'e':
+                options.checkEncoding = true;
+                break;
+        }
+    }
+}
+
+/**
+ * Finds a random walkable position around the given point, in pixels.
+ * Returns the point itself when no such position was found.
+ */
+static Point findWalkablePosition(MapComposite *composite, const Point &center,
+                                  int radius, unsigned char walkMask)
+{
+    const Map *map = composite->getMap();
+    const int tileWidth = map->getTileWidth();
+    const int tileHeight = map->getTileHeight();
+    const int cx = center.x / tileWidth;
+    const int cy = center.y / tileHeight;
+
+    for (int tries = 0; tries < 10; ++tries)
+    {
+        const int x = cx + std::rand() % (2 * radius + 1) - radius;
+        const int y = cy + std::rand() % (2 * radius + 1) - radius;
+        if (x < 0 || y < 0 || x >= map->getWidth() || y >= map->getHeight())
+            continue;
+
+        if (map->getWalk(x, y, walkMask))
+            return Point(x * tileWidth + tileWidth / 2,
+                         y * tileHeight + tileHeight / 2);
+    }
+    return center;
+}
+
+/**
+ * Creates a character the way the account server data would, and puts it on
+ * the map with a simulated client.
+ */
+static Entity *createCharacter(MapComposite *map, int id, const Point &pos,
+                               const CommandLineOptions &options)
+{
+    std::ostringstream name;
+    name << "Bench" << id;
+
+    MessageOut data(AGMSG_PLAYER_ENTER);
+    data.writeInt32(id);                // database id
+    data.writeString(name.str());
+    data.writeInt8(AL_PLAYER);          // account level
+    data.writeInt8(id % 2);             // gender
+    data.writeInt8(0);                  // hair style
+    data.writeInt8(0);                  // hair color
+    data.writeInt16(0);                 // attribute points
+    data.writeInt16(0);                 // correction points
+    data.writeInt16(3);                 // attributes
+    data.writeInt16(ATTR_MAX_HP);
+    data.writeDouble(100);
+    data.writeInt16(ATTR_HP);
+    data.writeDouble(100);
+    data.writeInt16(ATTR_MOVE_SPEED_TPS);
+    data.writeDouble(6);
+    data.writeInt16(0);                 // status effects
+    data.writeInt16(map->getID());
+    data.writeInt16(pos.x);
+    data.writeInt16(pos.y);
+    data.writeInt16(0);                 // kill counts
+    data.writeInt16(0);                 // abilities
+    data.writeInt16(0);                 // quest log
+
+    MessageIn msg(data.getData(), data.getLength());
+
+    Entity *character = new Entity(OBJECT_CHARACTER);
+    character->addComponent(new ActorComponent(*character));
+    character->addComponent(new BeingComponent(*character));
+    auto *characterComponent = new CharacterComponent(*character, msg);
+    character->addComponent(characterComponent);
+
+    GameClient *client = new GameClient(nullptr);
+    client->character = character;
+    client->status = CLIENT_CONNECTED;
+    client->setCompactEncoding(options.compact);
+    if (options.movementDeltas)
+        client->movementSnapshots.reset(new MovementSnapshots);
+    characterComponent->setClient(client);
+
+    if (!GameState::insert(character))
+    {
+        characterComponent->setClient(nullptr);
+        delete client;
+        delete character;
+        return nullptr;
+    }
+    characterComponent->markAllInfoAsChanged(*character);
+    return character;
+}
+
+static Entity *createMonster(MapComposite *map, MonsterClass *specy,
+                             const Point &pos)
+{
+    Entity *monster = new Entity(OBJECT_MONSTER);
+    auto *actorComponent = new ActorComponent(*monster);
+    monster->addComponent(actorComponent);
+    auto *beingComponent = new BeingComponent(*monster);
+    monster->addComponent(beingComponent);
+    monster->addComponent(new MonsterComponent(*monster, specy));
+
+    monster->setMap(map);
+    actorComponent->setPosition(*monster, pos);
+    beingComponent->clearDestination(*monster);
+
+    if (!GameState::insertOrDelete(monster))
+        return nullptr;
+    return monster;
+}
+
+/**
+ * Gives walkers that reached their destination, or have been walking for too
+ * long, a new destination around their home. When there is a target, the
+ * monsters walk next to it instead, like the example monster script does.
+ */
+static void moveWalkers(Walkers &walkers, int tick, int radius,
+                        Entity *target)
+{
+    int monsterIndex = 0;
+    for (Walkers::iterator it = walkers.begin(),
+         it_end = walkers.end(); it != it_end; ++it)
+    {
+        Entity *entity = it->entity;
+        if (!entity)
+            continue;
+
+        auto *beingComponent = entity->getComponent<BeingComponent>();
+        if (beingComponent->getAction() == DEAD)
+            continue;
+
+        auto *actorComponent = entity->getComponent<ActorComponent>();
+        if (target && entity->getType() == OBJECT_MONSTER)
+        {
+            // One of the four tiles around the target
+            static const int offsets[4][2] = {
+                { -1, 0 }, { 0, -1 }, { 1, 0 }, { 0, 1 }
+            };
+            const Map *map = entity->getMap()->getMap();
+            const int *offset = offsets[monsterIndex++ % 4];
+            Point dst =
+                    target->getComponent<ActorComponent>()->getPosition();
+            dst.x += offset[0] * map->getTileWidth();
+            dst.y += offset[1] * map->getTileHeight();
+            if (beingComponent->getDestination() != dst)
+                beingComponent->setDestination(*entity, dst);
+            continue;
+        }
+
+        const bool arrived = actorComponent->getPosition() ==
+                beingComponent->getDestination();
+        if (!arrived && tick < it->nextMove)
+            continue;
+
+        Point dst = findWalkablePosition(entity->getMap(), it->home, radius,
+                                         actorComponent->getWalkMask());
+        beingComponent->setDestination(*entity, dst);
+        it->nextMove = tick + 50 + std::rand() % 50;
+    }
+}
+
+/**
+ * Acknowledges the last movement update of each character, as if its client
+ * received it right away.
+ */
+static void acknowledgeMovements(const Walkers &walkers)
+{
+    for (Walkers::const_iterator it = walkers.begin(),
+         it_end = walkers.end(); it != it_end; ++it)
+    {
+        Entity *entity = it->entity;
+        if (!entity || entity->getType() != OBJECT_CHARACTER)
+            continue;
+
+        GameClient *client =
+                entity->getComponent<CharacterComponent>()->getClient();
+        if (MovementSnapshots *snapshots = client->movementSnapshots.get())
+            snapshots->acknowledge(snapshots->getLastSequence());
+    }
+}
+
+/**
+ * Measures the cost of finding the beings within visual range of each walker
+ * with the given zone size, the way informPlayer looks for them.
+ */
+static void benchmarkQueries(MapComposite *map, const Walkers &walkers,
+                             int zoneSize, int visualRange)
+{
+    static const int rounds = 20;
+
+    map->setZoneSize(zoneSize);
+
+    long long queries = 0, zones = 0, beings = 0, inRange = 0;
+    const std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (Walkers::const_iterator it = walkers.begin(),
+             it_end = walkers.end(); it != it_end; ++it)
+        {
+            if (!it->entity)
+                continue;
+
+            const Point &pos =
+                    it->entity->getComponent<ActorComponent>()->getPosition();
+            for (ZoneIterator z(map->getAroundPointIterator(pos, visualRange));
+                 z; ++z)
+                ++zones;
+
+            for (BeingIterator b(map->getAroundPointIterator(pos, visualRange));
+                 b; ++b)
+            {
+                ++beings;
+                const Point &other =
+                        (*b)->getComponent<ActorComponent>()->getPosition();
+                if (pos.inRangeOf(other, visualRange))
+                    ++inRange;
+            }
+            ++queries;
+        }
+    }
+
+    const long long elapsed =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+    if (!queries)
+        return;
+
+    std::cout << "  zones of " << zoneSize << " px: "
+              << elapsed / queries << " ns per query, "
+              << double(zones) / queries << " zones, "
+              << double(beings) / queries << " beings examined, "
+              << double(inRange) / queries << " in range" << std::endl;
+}
+
+/**
+ * Returns the cost of walking the given path from the given tile, counting
+ * diagonal steps as the square root of two straight ones.
+ */
+static double pathCost(int x, int y, const Path &path)
+{
+    double cost = 0;
+    for (Path::const_iterator it = path.begin(),
+         it_end = path.end(); it != it_end; ++it)
+    {
+        cost += (it->x != x && it->y != y) ? 1.41421356 : 1.0;
+        x = it->x;
+        y = it->y;
+    }
+    return cost;
+}
+
+/**
+ * Measures the path finding algorithms on the same random pairs of walkable
+ * tiles, and checks that they agree on the cost of the paths.
+ */
+static void benchmarkPaths(Map *map, int count)
+{
+    static const int maxCost = 200;
+    static const PathAlgorithm algorithms[] = { PATH_ASTAR, PATH_JUMP_POINT };
+    static const char *names[] = { "A*", "Jump Point Search" };
+    static const int nbAlgorithms = 2;
+
+    std::vector<Point> starts, destinations;
+    for (int tries = 0; (int) starts.size() < count && tries < count * 100;
+         ++tries)
+    {
+        const Point start(std::rand() % map->getWidth(),
+                          std::rand() % map->getHeight());
+        const Point destination(std::rand() % map->getWidth(),
+                                std::rand() % map->getHeight());
+        if (map->getWalk(start.x, start.y, Map::BLOCKMASK_WALL) &&
+            map->getWalk(destination.x, destination.y, Map::BLOCKMASK_WALL))
+        {
+            starts.push_back(start);
+            destinations.push_back(destination);
+        }
+    }
+
+    if (starts.empty())
+        return;
+
+    std::vector<double> costs[nbAlgorithms];
+    for (int a = 0; a < nbAlgorithms; ++a)
+    {
+        int found = 0;
+        const std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+
+        for (unsigned i = 0; i < starts.size(); ++i)
+        {
+            const Path path = map->findPath(starts[i].x, starts[i].y,
+                                            destinations[i].x,
+                                            destinations[i].y,
+                                            Map::BLOCKMASK_WALL, maxCost,
+                                            algorithms[a]);
+            costs[a].push_back(pathCost(starts[i].x, starts[i].y, path));
+            if (!path.empty())
+                ++found;
+        }
+
+        const long long elapsed =
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "  " << names[a] << ": "
+                  << elapsed / (long long) starts.size() << " us per path, "
+                  << found << " of " << starts.size() << " found"
+                  << std::endl;
+    }
+
+    int mismatches = 0;
+    for (unsigned i = 0; i < starts.size(); ++i)
+        if (std::abs(costs[0][i] - costs[1][i]) > 0.001)
+            ++mismatches;
+
+    std::cout << "  " << mismatches << " paths of a different cost"
+              << std::endl;
+
+    if (!map->getClusterGraph())
+        return;
+
+    // Plan routes through the cluster graph and walk each of their legs, the
+    // way beings do with distant destinations.
+    int found = 0, compared = 0;
+    double extraCost = 0;
+    const std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+    for (unsigned i = 0; i < starts.size(); ++i)
+    {
+        const Route route = map->findRoute(starts[i].x, starts[i].y,
+                                           destinations[i].x,
+                                           destinations[i].y);
+        Point from = starts[i];
+        double cost = 0;
+        bool complete = !route.empty();
+
+        for (Route::const_iterator it = route.begin(), it_end = route.end();
+             it != it_end && complete; ++it)
+        {
+            if (it->tile == from)
+                continue;
+
+            const Path path = map->findPath(from.x, from.y,
+                                            it->tile.x, it->tile.y,
+                                            Map::BLOCKMASK_WALL,
+                                            it->maxCost, PATH_ASTAR);
+            complete = !path.empty();
+            cost += pathCost(from.x, from.y, path);
+            from = it->tile;
+        }
+
+        if (!complete)
+            continue;
+
+        ++found;
+        if (costs[0][i] > 0)
+        {
+            extraCost += cost / costs[0][i] - 1;
+            ++compared;
+        }
+    }
+
+    const long long elapsed =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "  Routes through clusters of "
+              << map->getClusterGraph()->getClusterSize() << " tiles: "
+              << elapsed / (long long) starts.size() << " us per path, "
+              << found << " of " << starts.size() << " found, "
+              << (compared ? 100 * extraCost / compared : 0)
+              << "% longer than A*" << std::endl;
+}
+
+static void printReport(const CommandLineOptions &options, double tickMean,
+                        unsigned tickMax, unsigned long allocations,
+                        long long clientOutput, int nbCharacters,
+                        int nbMonsters, int zoneSize)
+{
+    const int ticks = options.ticks;
+
+    std::cout << "Map " << options.map << ", " << nbCharacters
+              << " characters, " << nbMonsters << " monsters, seed "
+              << options.seed << ", " << ticks << " ticks, zones of "
+              << zoneSize << " px" << std::endl;
+    std::cout << "Tick: mean " << tickMean << " us, max " << tickMax
+              << " us" << std::endl;
+
+    // The percentiles cover the last minute of simulated ticks at most.
+    for (int phase = 0; phase < NB_TICK_PHASES; ++phase)
+    {
+        TickPhase p = static_cast<TickPhase>(phase);
+        if (!TickProfiler::getPercentile(p, 100))
+            continue;
+
+        std::cout << "  " << getTickPhaseName(phase)
+                  << ": p50 " << TickProfiler::getPercentile(p, 50)
+                  << " us, p95 " << TickProfiler::getPercentile(p, 95)
+                  << " us, p99 " << TickProfiler::getPercentile(p, 99)
+                  << " us" << std::endl;
+    }
+
+    std::cout << "Allocations: " << allocations << " ("
+              << (ticks ? allocations / ticks : 0) << " per tick)"
+              << std::endl;
+    std::cout << "Client output: " << clientOutput << " bytes ("
+              << (ticks ? clientOutput / ticks : 0) << " per tick)"
+              << std::endl;
+}
+
+/**
+ * A value written to a message when checking the message encodings.
+ */
+struct EncodedValue
+{
+    EncodedValue(ValueType type, int value):
+        type(type),
+        value(value),
+        length(-1)
+    {}
+
+    EncodedValue(const std::string &string, int length = -1):
+        type(String),
+        value(0),
+        string(string),
+        length(length)
+    {}
+
+    ValueType type;
+    int value;
+    std::string string;
+    int length;         /**< Fixed length of the string, or -1. */
+};
+
+typedef std::vector< EncodedValue > EncodedValues;
+
+/** Message ID used for checking the encodings, any would do */
+static const int CHECK_MESSAGE_ID = GPMSG_BEINGS_MOVE;
+
+/** Number of failed encoding checks */
+static int encodingFailures = 0;
+
+static void checkEncoding(bool condition, const std::string &what)
+{
+    if (condition)
+        return;
+
+    std::cout << "  Failed: " << what << std::endl;
+    ++encodingFailures;
+}
+
+static void writeValues(MessageOut &msg, const EncodedValues &values)
+{
+    for (EncodedValues::const_iterator it = values.begin(),
+         it_end = values.end(); it != it_end; ++it)
+    {
+        switch (it->type)
+        {
+            case Int8:
+                msg.writeInt8(it->value);
+                break;
+            case Int16:
+                msg.writeInt16(it->value);
+                break;
+            case Int32:
+                msg.writeInt32(it->value);
+                break;
+            default:
+                msg.writeString(it->string, it->length);
+                break;
+        }
+    }
+}
+
+/**
+ * Reads back the values written by writeValues. Returns whether they are the
+ * ones expected, truncated to the size of their type, and whether the whole
+ * message was read.
+ */
+static bool readValues(MessageIn &msg, const EncodedValues &values)
+{
+    for (EncodedValues::const_iterator it = values.begin(),
+         it_end = values.end(); it != it_end; ++it)
+    {
+        switch (it->type)
+        {
+            case Int8:
+                if (msg.readInt8() != (unsigned char) it->value)
+                    return false;
+                break;
+            case Int16:
+                if (msg.readInt16() != (short) it->value)
+                    return false;
+                break;
+            case Int32:
+                if (msg.readInt32() != it->value)
+                    return false;
+                break;
+            default:
+            {
+                // Fixed length strings are cut or padded with zeros
+                std::string expected = it->string;
+                if (it->length >= 0)
+                    expected = expected.substr(0, it->length);
+                if (msg.readString(it->length) != expected)
+                    return false;
+                break;
+            }
+        }
+    }
+    return msg.getUnreadLength() == 0;
+}
+
+/**
+ * Checks that the values read back the same from the regular and compact
+ * encodings of a message.
+ */
+static void checkRoundTrip(const EncodedValues &values,
+                           const std::string &what)
+{
+    MessageOut msg(CHECK_MESSAGE_ID);
+    writeValues(msg, values);
+
+    MessageIn regular(msg.getData(), msg.getLength());
+    checkEncoding(regular.getId() == CHECK_MESSAGE_ID &&
+                  readValues(regular, values), what + ", regular");
+
+    std::vector<char> data;
+    msg.encodeCompact(data);
+    MessageIn compact(&data[0], data.size(), true);
+    checkEncoding(compact.getId() == CHECK_MESSAGE_ID &&
+                  readValues(compact, values), what + ", compact");
+}
+
+/**
+ * Returns the number of bytes taken by a 32-bit integer in the compact
+ * encoding. Only meaningful without debug mode.
+ */
+static unsigned compactSize(int value)
+{
+    MessageOut msg(CHECK_MESSAGE_ID);
+    msg.writeInt32(value);
+
+    std::vector<char> data;
+    msg.encodeCompact(data);
+    return data.size() - 2;
+}
+
+static int randomInt()
+{
+    return int((unsigned(std::rand()) << 16) ^ unsigned(std::rand()));
+}
+
+static EncodedValue randomValue()
+{
+    switch (std::rand() % 4)
+    {
+        case 0:
+            return EncodedValue(Int8, randomInt() % 256);
+        case 1:
+            return EncodedValue(Int16, short(randomInt()));
+        case 2:
+        {
+            // Mostly small values, as are most of those sent
+            const int value = randomInt();
+            return EncodedValue(Int32, std::rand() % 2 ? value : value % 200);
+        }
+        default:
+        {
+            std::string string(std::rand() % 200, ' ');
+            for (std::string::iterator it = string.begin(),
+                 it_end = string.end(); it != it_end; ++it)
+            {
+                *it = 'a' + std::rand() % 26;
+            }
+            const int length = std::rand() % 3 ? -1 : std::rand() % 250;
+            return EncodedValue(string, length);
+        }
+    }
+}
+
+/**
+ * Checks that messages of the given values, and of random ones, read back
+ * the same in both encodings.
+ */
+static void checkRoundTrips()
+{
+    EncodedValues values;
+    values.push_back(EncodedValue(Int8, 0));
+    values.push_back(EncodedValue(Int8, 127));
+    values.push_back(EncodedValue(Int8, 128));
+    values.push_back(EncodedValue(Int8, 255));
+    values.push_back(EncodedValue(Int8, -1));
+    checkRoundTrip(values, "8-bit limits");
+
+    values.clear();
+    values.push_back(EncodedValue(Int16, -32768));
+    values.push_back(EncodedValue(Int16, 32767));
+    values.push_back(EncodedValue(Int16, -1));
+    values.push_back(EncodedValue(Int16, 0));
+    values.push_back(EncodedValue(Int16, 1));
+    values.push_back(EncodedValue(Int16, 65535));
+    checkRoundTrip(values, "16-bit limits");
+
+    values.clear();
+    values.push_back(EncodedValue(Int32, INT32_MIN));
+    values.push_back(EncodedValue(Int32, INT32_MAX));
+    values.push_back(EncodedValue(Int32, -1));
+    values.push_back(EncodedValue(Int32, 0));
+    values.push_back(EncodedValue(Int32, 1));
+    values.push_back(EncodedValue(Int32, -64));
+    values.push_back(EncodedValue(Int32, 64));
+    checkRoundTrip(values, "32-bit limits");
+
+    values.clear();
+    values.push_back(EncodedValue(std::string()));
+    values.push_back(EncodedValue("short"));
+    values.push_back(EncodedValue(std::string(300, 'x')));
+    values.push_back(EncodedValue("padded", 24));
+    values.push_back(EncodedValue("truncated", 4));
+    values.push_back(EncodedValue("empty", 0));
+    checkRoundTrip(values, "strings");
+
+    // Enough values for the integers not to be tracked inline
+    for (int i = 0; i < 1000; ++i)
+    {
+        values.clear();
+        const int count = std::rand() % 40;
+        for (int j = 0; j < count; ++j)
+            values.push_back(randomValue());
+
+        std::ostringstream what;
+        what << "random message " << i;
+        checkRoundTrip(values, what.str());
+    }
+}
+
+/**
+ * Checks that truncated integers and strings are rejected rather than read
+ * past the end of the data.
+ */
+static void checkTruncated()
+{
+    MessageOut msg(CHECK_MESSAGE_ID);
+    msg.writeInt32(INT32_MIN);
+    msg.writeString("truncated");
+
+    std::vector<char> data;
+    msg.encodeCompact(data);
+
+    // The five bytes of the integer, cut anywhere
+    for (unsigned length = 2; length < 7; ++length)
+    {
+        MessageIn in(&data[0], length, true);
+        std::ostringstream what;
+        what << "integer truncated to " << length << " bytes";
+        checkEncoding(in.readInt32() == -1 && in.getUnreadLength() < 0,
+                      what.str());
+    }
+
+    // The string, cut after its length
+    for (unsigned length = 8; length < data.size(); ++length)
+    {
+        MessageIn in(&data[0], length, true);
+        in.readInt32();
+        std::ostringstream what;
+        what << "string truncated to " << length << " bytes";
+        checkEncoding(in.readString().empty() && in.getUnreadLength() < 0,
+                      what.str());
+    }
+
+    // An integer that does not end within five bytes
+    std::vector<char> tooLong(data.begin(), data.begin() + 2);
+    tooLong.insert(tooLong.end(), 5, char(0xff));
+    tooLong.push_back(0);
+    MessageIn in(&tooLong[0], tooLong.size(), true);
+    checkEncoding(in.readInt32() == -1 && in.getUnreadLength() < 0,
+                  "integer longer than five bytes");
+}
+
+/**
+ * The destination and speed of a being, as known by a client.
+ */
+struct KnownMovement
+{
+    Point destination;
+    int speed;
+};
+
+typedef std::map< int, KnownMovement > KnownMovements;
+
+/**
+ * Returns whether the snapshots hold the given movements for the beings with
+ * IDs up to \a maxId, and no others.
+ */
+static bool snapshotsMatch(const MovementSnapshots &snapshots,
+                           const KnownMovements &movements, int maxId)
+{
+    for (int id = 1; id <= maxId; ++id)
+    {
+        KnownMovements::const_iterator it = movements.find(id);
+        Point destination;
+        int speed;
+        if (!snapshots.getKnownState(id, destination, speed))
+        {
+            if (it != movements.end())
+                return false;
+        }
+        else if (it == movements.end() ||
+                 it->second.destination != destination ||
+                 it->second.speed != speed)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * The movements of the beings as a client rebuilds them from the
+ * GPMSG_BEINGS_MOVE_DELTA messages, for checking them against what the
+ * server believes the client knows.
+ */
+class MovementClient
+{
+    public:
+        MovementClient():
+            mLastSequence(0),
+            mLastKeyframe(false)
+        {}
+
+        /**
+         * Reads an update as the client would. Returns false when it is
+         * relative to an update the client does not have, or malformed.
+         */
+        bool receive(MessageOut &msg);
+
+        /**
+         * Returns whether the client knows the same as the server after the
+         * last update it received, for the beings with IDs up to \a maxId.
+         * Beings the server forgot may only remain when the update was no
+         * keyframe.
+         */
+        bool matches(const MovementSnapshots &snapshots, int maxId) const;
+
+        bool hasReceived() const
+        { return !mReceived.empty(); }
+
+        unsigned getLastSequence() const
+        { return mLastSequence; }
+
+    private:
+        std::map< unsigned, KnownMovements > mReceived;
+        unsigned mLastSequence;
+        bool mLastKeyframe;
+};
+
+bool MovementClient::receive(MessageOut &msg)
+{
+    MessageIn in(msg.getData(), msg.getLength());
+    const unsigned sequence = in.readInt16() & 0xFFFF;
+    const unsigned baseSequence = in.readInt16() & 0xFFFF;
+
+    KnownMovements movements;
+    if (baseSequence != sequence)
+    {
+        std::map< unsigned, KnownMovements >::const_iterator base =
+                mReceived.find(baseSequence);
+        if (base == mReceived.end())
+            return false;
+        movements = base->second;
+    }
+
+    while (in.getUnreadLength() > 0)
+    {
+        const int id = in.readInt16();
+        const int flags = in.readInt8();
+        const bool known = movements.count(id);
+        KnownMovement &movement = movements[id];
+
+        if (flags & MOVING_POSITION)
+        {
+            in.readInt16();
+            in.readInt16();
+        }
+        if (flags & MOVING_DESTINATION)
+        {
+            movement.destination.x = in.readInt16();
+            movement.destination.y = in.readInt16();
+        }
+        else if (flags & MOVING_DESTINATION_CHANGE)
+        {
+            if (!known)
+                return false;
+            movement.destination.x += (signed char) in.readInt8();
+            movement.destination.y += (signed char) in.readInt8();
+        }
+        else if (!known)
+        {
+            return false;
+        }
+        if (flags & MOVING_SPEED)
+            movement.speed = in.readInt8();
+        else if (!known)
+            return false;
+    }
+
+    mReceived[sequence] = movements;
+    mLastSequence = sequence;
+    mLastKeyframe = baseSequence == sequence;
+    return in.getUnreadLength() == 0;
+}
+
+bool MovementClient::matches(const MovementSnapshots &snapshots,
+                             int maxId) const
+{
+    std::map< unsigned, KnownMovements >::const_iterator last =
+            mReceived.find(mLastSequence);
+    if (last == mReceived.end())
+        return false;
+    const KnownMovements &movements = last->second;
+
+    for (int id = 1; id <= maxId; ++id)
+    {
+        KnownMovements::const_iterator it = movements.find(id);
+        Point destination;
+        int speed;
+        if (!snapshots.getKnownState(id, destination, speed))
+        {
+            if (mLastKeyframe && it != movements.end())
+                return false;
+            continue;
+        }
+
+        if (it == movements.end() ||
+            it->second.destination != destination ||
+            it->second.speed != speed)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Writes the update of a tick and, unless it is lost, gives it to the client.
+ * Checks that the server believes the client knows the expected movements,
+ * and that the client rebuilt them.
+ */
+static void checkMovementUpdate(MovementSnapshots &snapshots,
+                                MovementClient &client,
+                                const KnownMovements &expected, bool keyframe,
+                                bool lost, int maxId, const std::string &what)
+{
+    MessageOut msg(GPMSG_BEINGS_MOVE_DELTA);
+    const bool written = snapshots.write(msg, keyframe);
+
+    checkEncoding(snapshotsMatch(snapshots, expected, maxId),
+                  what + ", server");
+
+    if (written && !lost)
+    {
+        checkEncoding(client.receive(msg) &&
+                      client.matches(snapshots, maxId), what + ", client");
+    }
+}
+
+/**
+ * Records a change of destination in the snapshots and in the expected
+ * movements.
+ */
+static void moveBeing(MovementSnapshots &snapshots, KnownMovements &expected,
+                      int id, int flags, const Point &destination, int speed)
+{
+    snapshots.update(id, flags, Point(), destination, speed);
+    expected[id].destination = destination;
+    expected[id].speed = speed;
+}
+
+/**
+ * Makes a being leave the sight of the client.
+ */
+static void removeBeing(MovementSnapshots &snapshots,
+                        KnownMovements &expected, int id)
+{
+    snapshots.remove(id);
+    expected.erase(id);
+}
+
+/**
+ * Checks that a client rebuilds the movements the server believes it knows,
+ * in spite of lost updates and of beings leaving its sight.
+ */
+static void checkMovementDeltas()
+{
+    MovementSnapshots snapshots;
+    MovementClient client;
+    KnownMovements expected;
+
+    // A destination lost and never sent again is described by the keyframe
+    moveBeing(snapshots, expected, 1, MOVING_DESTINATION, Point(100, 100), 50);
+    moveBeing(snapshots, expected, 2, MOVING_DESTINATION, Point(200, 200), 50);
+    moveBeing(snapshots, expected, 3, MOVING_DESTINATION, Point(300, 300), 50);
+    checkMovementUpdate(snapshots, client, expected, false, false, 3,
+                        "first update");
+    snapshots.acknowledge(client.getLastSequence());
+
+    moveBeing(snapshots, expected, 1, MOVING_DESTINATION, Point(110, 90), 50);
+    checkMovementUpdate(snapshots, client, expected, false, true, 3,
+                        "lost update");
+    checkMovementUpdate(snapshots, client, expected, true, false, 3,
+                        "keyframe after a lost update");
+
+    // Beings out of sight are left out of the keyframes
+    removeBeing(snapshots, expected, 2);
+    checkMovementUpdate(snapshots, client, expected, true, false, 3,
+                        "keyframe after a being left");
+
+    // Random movements, losses, acknowledgments and departures
+    const int maxId = 30;
+    for (int tick = 1; tick <= 5000; ++tick)
+    {
+        for (int id = 1; id <= maxId; ++id)
+        {
+            const int roll = std::rand() % 100;
+            if (roll < 2)
+            {
+                removeBeing(snapshots, expected, id);
+            }
+            else if (roll < 20)
+            {
+                // Mostly small changes, sometimes a jump
+                Point destination(std::rand() % 2000, std::rand() % 2000);
+                int speed = 40 + std::rand() % 20;
+                KnownMovements::const_iterator known = expected.find(id);
+                if (roll < 15 && known != expected.end())
+                {
+                    const Point &last = known->second.destination;
+                    destination.x = last.x + std::rand() % 64 - 32;
+                    destination.y = last.y + std::rand() % 64 - 32;
+                    speed = known->second.speed;
+                }
+                const int flags = MOVING_DESTINATION |
+                        (std::rand() % 10 ? 0 : MOVING_POSITION);
+                moveBeing(snapshots, expected, id, flags, destination, speed);
+            }
+        }
+
+        std::ostringstream what;
+        what << "movement update of tick " << tick;
+        checkMovementUpdate(snapshots, client, expected, tick % 50 == 0,
+                            std::rand() % 5 == 0, maxId, what.str());
+
+        // Acknowledgments get lost as well
+        if (client.hasReceived() && std::rand() % 3)
+            snapshots.acknowledge(client.getLastSequence());
+    }
+}
+
+/**
+ * Checks the compact encoding of the messages against the regular one, and
+ * the movement deltas against what the server believes the client knows.
+ * Returns the number of failed checks.
+ */
+static int checkMessageEncoding()
+{
+    MessageOut::setCompactEncodingEnabled(true);
+
+    // Zigzag encoding keeps the integers close to 0 short, either sign
+    checkEncoding(compactSize(0) == 1, "size of 0");
+    checkEncoding(compactSize(-1) == 1, "size of -1");
+    checkEncoding(compactSize(63) == 1, "size of 63");
+    checkEncoding(compactSize(-64) == 1, "size of -64");
+    checkEncoding(compactSize(64) == 2, "size of 64");
+    checkEncoding(compactSize(-65) == 2, "size of -65");
+    checkEncoding(compactSize(INT32_MAX) == 5, "size of the 32-bit maximum");
+    checkEncoding(compactSize(INT32_MIN) == 5, "size of the 32-bit minimum");
+
+    std::cout << "Round trips:" << std::endl;
+    checkRoundTrips();
+    std::cout << "Round trips in debug mode:" << std::endl;
+    MessageOut::setDebugModeEnabled(true);
+    checkRoundTrips();
+    MessageOut::setDebugModeEnabled(false);
+
+    std::cout << "Truncated messages:" << std::endl;
+    checkTruncated();
+
+    std::cout << "Movement deltas:" << std::endl;
+    checkMovementDeltas();
+
+    std::cout << "Encoding checks: " << encodingFailures << " failed"
+              << std::endl;
+    return encodingFailures;
+}
+
+/**
+ * Main function, sets up the simulation and runs it.
+ */
+int main(int argc, char *argv[])
+{
+    CommandLineOptions options;
+    parseOptions(argc, argv, options);
+
+    // The defaults are fine for a benchmark, so the file is optional.
+    Configuration::initialize(options.configPath);
+    Logger::setVerbosity(options.verbosity);
+
+    if (options.checkEncoding)
+    {
+        std::srand(options.seed);
+        return checkMessageEncoding() ? EXIT_FAILURE : EXIT_NORMAL;
+    }
+
+    GameServer::initialize(DEFAULT_LOG_FILE);
+    MessageOut::setCompactEncodingEnabled(options.compact);
+    std::srand(options.seed);
+
+    MapComposite *map = MapManager::getMap(atoi(options.map.c_str()));
+    if (!map)
+        map = MapManager::getMap(options.map);
+    if (!map || !MapManager::activateMap(map->getID()))
+    {
+        std::cerr << "Unable to load map " << options.map << std::endl;
+        return EXIT_MAP_FILE_NOT_FOUND;
+    }
+
+    if (options.zoneSize > 0)
+        map->setZoneSize(options.zoneSize);
+    const int zoneSize = map->getZoneSize();
+
+    MonsterClass *specy = nullptr;
+    const MonsterClasses &monsterClasses = monsterManager->getMonsterClasses();
+    if (options.monsterId)
+        specy = monsterManager->getMonster(options.monsterId);
+    else if (!monsterClasses.empty())
+        specy = monsterClasses.begin()->second;
+    if (options.monsters > 0 && !specy)
+    {
+        std::cerr << "Unknown monster " << options.monsterId << std::endl;
+        return EXIT_BAD_CONFIG_PARAMETER;
+    }
+
+    const Map *realMap = map->getMap();
+    const Point mapCenter(realMap->getWidth() * realMap->getTileWidth() / 2,
+                          realMap->getHeight() * realMap->getTileHeight() / 2);
+    const int spread = std::max(realMap->getWidth(), realMap->getHeight()) / 2;
+
+    Walkers walkers;
+    int nbCharacters = 0, nbMonsters = 0;
+
+    for (int i = 0; i < options.characters; ++i)
+    {
+        const Point pos = findWalkablePosition(map, mapCenter, spread,
+                                               Map::BLOCKMASK_WALL);
+        if (Entity *character = createCharacter(map, i + 1, pos, options))
+        {
+            walkers.push_back(Walker(character, pos));
+            character->signal_removed.connect(
+                    sigc::mem_fun(&walkers.back(), &Walker::removed));
+            ++nbCharacters;
+        }
+    }
+
+    // The chased character is surrounded by the monsters from the start
+    Entity *target = nullptr;
+    Point monsterCenter = mapCenter;
+    int monsterSpread = spread;
+    if (options.chase && !walkers.empty())
+    {
+        target = walkers.front().entity;
+        monsterCenter = walkers.front().home;
+        monsterSpread = options.walkRadius;
+    }
+
+    for (int i = 0; i < options.monsters; ++i)
+    {
+        const Point pos = findWalkablePosition(map, monsterCenter,
+                                               monsterSpread,
+                                               Map::BLOCKMASK_WALL);
+        if (Entity *monster = createMonster(map, specy, pos))
+        {
+            walkers.push_back(Walker(monster, pos));
+            monster->signal_removed.connect(
+                    sigc::mem_fun(&walkers.back(), &Walker::removed));
+            ++nbMonsters;
+        }
+    }
+
+    int tick = 0;
+    for (; tick < options.warmup; ++tick)
+    {
+        moveWalkers(walkers, tick, options.walkRadius, target);
+        GameState::update(tick);
+        acknowledgeMovements(walkers);
+    }
+
+    TickProfiler::reset();
+    const unsigned long allocationsBefore = allocationCount;
+    const long long clientOutputBefore = gBandwidth->totalClientOut();
+    long long totalTime = 0;
+    unsigned maxTime = 0;
+
+    for (int i = 0; i < options.ticks; ++i, ++tick)
+    {
+        TickProfiler::Stopwatch stopwatch;
+        moveWalkers(walkers, tick, options.walkRadius, target);
+        GameState::update(tick);
+        const unsigned time = stopwatch.lap();
+        acknowledgeMovements(walkers);
+
+        TickProfiler::addSample(TICK_PHASE_TOTAL, time);
+        totalTime += time;
+        maxTime = std::max(maxTime, time);
+    }
+
+    printReport(options,
+                options.ticks ? double(totalTime) / options.ticks : 0.0,
+                maxTime, allocationCount - allocationsBefore,
+                gBandwidth->totalClientOut() - clientOutputBefore,
+                nbCharacters, nbMonsters, zoneSize);
+
+    // Compare the cost of area queries on the final positions of the beings
+    // with a few zone sizes.
+    std::cout << "Area queries:" << std::endl;
+    const int visualRange = GameState::visualRangeOption;
+    static const int zoneSizes[] = { 128, 256, 512, 1024 };
+    for (unsigned i = 0; i < sizeof(zoneSizes) / sizeof(zoneSizes[0]); ++i)
+        benchmarkQueries(map, walkers, zoneSizes[i], visualRange);
+    benchmarkQueries(map, walkers, zoneSize, visualRange);
+
+    if (options.paths > 0)
+    {
+        std::cout << "Path finding:" << std::endl;
+        benchmarkPaths(map->getMap(), options.paths);
+    }
+
+    GameServer::deinitialize();
+
+    return EXIT_NORMAL;
+}
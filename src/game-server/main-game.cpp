@@ -21,35 +21,21 @@
 
 #include "common/configuration.h"
 #include "common/defines.h"
-#include "common/permissionmanager.h"
-#include "common/resourcemanager.h"
 #include "game-server/accountconnection.h"
-#include "game-server/attributemanager.h"
 #include "game-server/gamehandler.h"
-#include "game-server/emotemanager.h"
-#include "game-server/itemmanager.h"
-#include "game-server/mapmanager.h"
-#include "game-server/monstermanager.h"
-#include "game-server/abilitymanager.h"
-#include "game-server/statusmanager.h"
-#include "game-server/postman.h"
+#include "game-server/gameserver.h"
 #include "game-server/state.h"
-#include "game-server/settingsmanager.h"
+#include "game-server/tickprofiler.h"
 #include "net/bandwidth.h"
 #include "net/connectionhandler.h"
 #include "net/messageout.h"
-#include "scripting/scriptmanager.h"
 #include "utils/logger.h"
-#include "utils/processorutils.h"
-#include "utils/stringfilter.h"
 #include "utils/timer.h"
-#include "utils/mathutils.h"
 
 #include <cstdlib>
 #include <getopt.h>
 #include <iostream>
 #include <signal.h>
-#include <physfs.h>
 #include <enet/enet.h>
 #include <unistd.h>
 
@@ -66,7 +52,6 @@
 using utils::Logger;
 
 #define DEFAULT_LOG_FILE                    "manaserv-game.log"
-#define DEFAULT_MAIN_SCRIPT_FILE            "scripts/main.lua"
 
 static int const WORLD_TICK_SKIP = 2; /** tolerance for lagging behind in world calculation) **/
 
@@ -75,28 +60,6 @@ static utils::Timer worldTimer(WORLD_TICK_MS);
 static int currentTick = 0;     /**< Current world time in ticks */
 static bool running = true;     /**< Whether the server keeps running */
 
-utils::StringFilter *stringFilter; /**< Slang's Filter */
-
-AbilityManager *abilityManager = new AbilityManager();
-AttributeManager *attributeManager = new AttributeManager();
-ItemManager *itemManager = new ItemManager();
-MonsterManager *monsterManager = new MonsterManager();
-EmoteManager *emoteManager = new EmoteManager();
-
-SettingsManager *settingsManager = new SettingsManager(DEFAULT_SETTINGS_FILE);
-
-/** Core game message handler */
-GameHandler *gameHandler;
-
-/** Account server message handler */
-AccountConnection *accountHandler;
-
-/** Post Man **/
-PostMan *postMan;
-
-/** Bandwidth Monitor */
-BandwidthMonitor *gBandwidth;
-
 /** Callback used when SIGQUIT signal is received. */
 static void closeGracefully(int)
 {
@@ -112,38 +75,8 @@ static void initializeServer()
     signal(SIGINT, closeGracefully);
     signal(SIGTERM, closeGracefully);
 
-    std::string logFile = Configuration::getValue("log_gameServerFile",
-                                                  DEFAULT_LOG_FILE);
-
-    // Initialize PhysicsFS
-    PHYSFS_init("");
-
-    Logger::initialize(logFile);
-
-    // --- Initialize the managers
-    // Initialize the slang's and double quotes filter.
-    stringFilter = new utils::StringFilter;
-
-    ResourceManager::initialize();
-    ScriptManager::initialize();   // Depends on ResourceManager
-
-    // load game settings files
-    settingsManager->initialize();
-
-    PermissionManager::initialize(DEFAULT_PERMISSION_FILE);
-
-
-    std::string mainScript = Configuration::getValue("script_mainFile",
-                                                     DEFAULT_MAIN_SCRIPT_FILE);
-    ScriptManager::loadMainScript(mainScript);
-
-    // --- Initialize the global handlers
-    // FIXME: Make the global handlers global vars or part of a bigger
-    // singleton or a local variable in the event-loop
-    gameHandler = new GameHandler;
-    accountHandler = new AccountConnection;
-    postMan = new PostMan;
-    gBandwidth = new BandwidthMonitor;
+    // Shared with the benchmark
+    GameServer::initialize(DEFAULT_LOG_FILE);
 
     // --- Initialize enet.
     if (enet_initialize() != 0)
@@ -152,12 +85,6 @@ static void initializeServer()
         exit(EXIT_NET_EXCEPTION);
     }
 
-    // Pre-calculate the needed trigomic function values
-    utils::math::init();
-
-    // Initialize the processor utility functions
-    utils::processor::init();
-
     // Seed the random number generator
     std::srand( time(nullptr) );
 }
@@ -165,33 +92,13 @@ static void initializeServer()
 
 static void deinitializeServer()
 {
-    // Write configuration file
-    Configuration::deinitialize();
-
     // Stop world timer
     worldTimer.stop();
 
     // Quit ENet
     enet_deinitialize();
 
-    // Destroy message handlers
-    delete gameHandler; gameHandler = 0;
-    delete accountHandler; accountHandler = 0;
-    delete postMan; postMan = 0;
-    delete gBandwidth; gBandwidth = 0;
-
-    // Destroy Managers
-    delete stringFilter; stringFilter = 0;
-    delete monsterManager; monsterManager = 0;
-    delete abilityManager; abilityManager = 0;
-    delete itemManager; itemManager = 0;
-    delete emoteManager; emoteManager = 0;
-    delete settingsManager; settingsManager = 0;
-    MapManager::deinitialize();
-    StatusManager::deinitialize();
-    ScriptManager::deinitialize();
-
-    PHYSFS_deinit();
+    GameServer::deinitialize();
 }
 
 
@@ -341,6 +248,10 @@ int main(int argc, char *argv[])
     bool debugNetwork = Configuration::getBoolValue("net_debugMode", false);
     MessageOut::setDebugModeEnabled(debugNetwork);
 
+    bool compactMessages = Configuration::getBoolValue("net_compactMessages",
+                                                       false);
+    MessageOut::setCompactEncodingEnabled(compactMessages);
+
     // Make an initial attempt to connect to the account server
     // Try again after longer and longer intervals when connection fails.
     bool isConnected = false;
@@ -389,6 +300,9 @@ int main(int argc, char *argv[])
             currentTick++;
             elapsedTicks--;
 
+            TickProfiler::Stopwatch tickStopwatch;
+            TickProfiler::Stopwatch phaseStopwatch;
+
             // Print world time at 10 second intervals to show we're alive
             if (currentTick % 100 == 0)
                 LOG_INFO("World time: " << currentTick);
@@ -399,6 +313,8 @@ int main(int argc, char *argv[])
 
                 // Handle all messages that are in the message queues
                 accountHandler->process();
+                TickProfiler::addSample(ManaServ::TICK_PHASE_ACCOUNT,
+                                        phaseStopwatch.lap());
 
                 if (currentTick % 100 == 0) {
                     accountHandler->syncChanges(true);
@@ -430,11 +346,23 @@ int main(int argc, char *argv[])
                     accountHandler->start(options.port);
                 }
             }
+
+            if (currentTick % 300 == 0)
+                TickProfiler::logSummary();
+
+            phaseStopwatch.lap();
             gameHandler->process();
+            TickProfiler::addSample(ManaServ::TICK_PHASE_GAME,
+                                    phaseStopwatch.lap());
             // Update all active objects/beings
             GameState::update(currentTick);
+            phaseStopwatch.lap();
             // Send potentially urgent outgoing messages
             gameHandler->flush();
+            TickProfiler::addSample(ManaServ::TICK_PHASE_FLUSH,
+                                    phaseStopwatch.lap());
+            TickProfiler::addSample(ManaServ::TICK_PHASE_TOTAL,
+                                    tickStopwatch.lap());
         }
     }
 
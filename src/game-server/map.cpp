@@ -26,8 +26,29 @@
 
 #include "game-server/map.h"
 
+#include "game-server/clustergraph.h"
+
+#include "common/configuration.h"
 #include "common/defines.h"
 
+/**
+ * The path finding algorithm used when none is asked for: "astar" or "jps".
+ */
+static Configuration::StringOption pathFinderOption("game_pathFinder",
+                                                    "astar");
+
+// Basic cost for moving from one tile to another.
+static int const basicCost = 100;
+
+// Cost of a diagonal step, ~sqrt(2) times the basic cost.
+static int const diagonalCost = basicCost * 362 / 256;
+
+/* Cost of a horizontal or vertical step. They are demoted by a small defect,
+   so that two consecutive directions cannot have the same Fcost.
+   Important: as long as the total defect along any path is less than the
+   basicCost, the pathfinder will still find one of the shortest paths! */
+static int const straightCost = basicCost + 1;
+
 /**
  * Stores information used during path finding for each tile of a map.
  */
@@ -49,6 +70,26 @@ class PathInfo
         int parentY;            /**< Y coordinate of parent tile */
 };
 
+/**
+ * A location on a tile map. Used for pathfinding, open list.
+ */
+class Location
+{
+    public:
+        Location(int x, int y, int Fcost):
+            x(x), y(y), Fcost(Fcost)
+        {}
+
+        /**
+         * Comparison operator.
+         */
+        bool operator< (const Location &other) const
+        { return Fcost > other.Fcost; }
+
+        int x, y;
+        int Fcost;              /**< Estimation of total path cost */
+};
+
 /**
  * A helper class for finding a path on a map, functor style.
  */
@@ -56,6 +97,10 @@ class FindPath
 {
     public:
         FindPath() :
+            mMap(nullptr),
+            mWalkmask(0),
+            mDestX(0), mDestY(0),
+            mCurrX(0), mCurrY(0),
             mWidth(0),
             mOnClosedList(1),
             mOnOpenList(2)
@@ -66,49 +111,74 @@ class FindPath
                          unsigned char walkmask, int maxCost,
                          const Map *map);
 
+        /**
+         * Finds a path with Jump Point Search. Rather than adding every
+         * neighbour of a tile to the open list, it scans ahead in straight
+         * lines and only adds the tiles where the path may need to turn.
+         */
+        Path jumpPoint(int startX, int startY,
+                       int destX, int destY,
+                       unsigned char walkmask, int maxCost,
+                       const Map *map);
+
     private:
         PathInfo *getInfo(int x, int y)
         { return &mPathInfos.at(x + y * mWidth); }
 
         void prepare(const Map *map);
 
+        void addJumpPoint(int dx, int dy, int Gcost, int budget);
+
+        bool jumpStraight(int &x, int &y, int dx, int dy, int &cost,
+                          int budget) const;
+        bool jumpDiagonal(int &x, int &y, int dx, int dy, int &cost,
+                          int budget) const;
+
+        bool walkable(int x, int y) const
+        { return mMap->getWalk(x, y, mWalkmask); }
+
+        /**
+         * Estimates the cost from the given tile to the destination, never
+         * overestimating it.
+         */
+        int heuristic(int x, int y) const
+        {
+            const int dx = std::abs(x - mDestX), dy = std::abs(y - mDestY);
+            return std::abs(dx - dy) * basicCost +
+                std::min(dx, dy) * diagonalCost;
+        }
+
+        // Parameters of the current jump point search
+        const Map *mMap;
+        unsigned char mWalkmask;
+        int mDestX, mDestY;
+        int mCurrX, mCurrY;
+        std::priority_queue<Location> mOpenList;
+
         int mWidth;
         std::vector<PathInfo> mPathInfos;
         unsigned mOnClosedList, mOnOpenList;
 };
 
-static FindPath findPath;
-
-
 /**
- * A location on a tile map. Used for pathfinding, open list.
+ * Each thread has its own path finder, as maps can be updated concurrently.
  */
-class Location
-{
-    public:
-        Location(int x, int y, int Fcost):
-            x(x), y(y), Fcost(Fcost)
-        {}
-
-        /**
-         * Comparison operator.
-         */
-        bool operator< (const Location &other) const
-        { return Fcost > other.Fcost; }
+static thread_local FindPath findPath;
 
-        int x, y;
-        int Fcost;              /**< Estimation of total path cost */
-};
 
 Map::Map(int width, int height, int tileWidth, int tileHeight):
-    mWidth(width), mHeight(height),
+    mWidth(0), mHeight(0),
     mTileWidth(tileWidth), mTileHeight(tileHeight),
-    mMetaTiles(width * height)
+    mRowWords(0),
+    mClusterGraph(nullptr)
 {
+    setSize(width, height);
 }
 
 Map::~Map()
 {
+    delete mClusterGraph;
+
     for (std::vector<MapObject*>::iterator it = mMapObjects.begin();
          it != mMapObjects.end(); ++it)
     {
@@ -121,7 +191,17 @@ void Map::setSize(int width, int height)
     mWidth = width;
     mHeight = height;
 
-    mMetaTiles.resize(width * height);
+    mRowWords = (width + 63) / 64;
+    mBlockPlanes.assign(height * NB_BLOCKTYPES * mRowWords, 0);
+
+    for (unsigned i = 0; i < NB_BLOCKTYPES; ++i)
+    {
+        mExtraOccupation[i].clear();
+        mWalkVersions[i] = 0;
+    }
+
+    delete mClusterGraph;
+    mClusterGraph = nullptr;
 }
 
 const std::string &Map::getProperty(const std::string &key) const
@@ -134,32 +214,46 @@ const std::string &Map::getProperty(const std::string &key) const
     return i->second;
 }
 
+/**
+ * Returns the bit of the blocking bitmasks matching a block type.
+ */
+static unsigned char blockMask(BlockType type)
+{
+    switch (type)
+    {
+        case BLOCKTYPE_WALL:
+            return Map::BLOCKMASK_WALL;
+        case BLOCKTYPE_CHARACTER:
+            return Map::BLOCKMASK_CHARACTER;
+        case BLOCKTYPE_MONSTER:
+            return Map::BLOCKMASK_MONSTER;
+        default:
+            return 0;
+    }
+}
+
 void Map::blockTile(int x, int y, BlockType type)
 {
     if (type == BLOCKTYPE_NONE || !contains(x, y))
         return;
 
-    MetaTile &metaTile = mMetaTiles[x + y * mWidth];
+    uint64_t &word = mBlockPlanes[getBlockIndex(x, y, type)];
+    const uint64_t bit = uint64_t(1) << (x & 63);
 
-    if (metaTile.occupation[type] < UINT_MAX &&
-        (++metaTile.occupation[type]) > 0)
+    if (word & bit)
     {
-        switch (type)
-        {
-            case BLOCKTYPE_WALL:
-                metaTile.blockmask |= BLOCKMASK_WALL;
-                break;
-            case BLOCKTYPE_CHARACTER:
-                metaTile.blockmask |= BLOCKMASK_CHARACTER;
-                break;
-            case BLOCKTYPE_MONSTER:
-                metaTile.blockmask |= BLOCKMASK_MONSTER;
-                break;
-            default:
-                // Nothing to do.
-                break;
-        }
+        // Already blocked, only count it
+        unsigned &extra = mExtraOccupation[type][x + y * mWidth];
+        if (extra < UINT_MAX)
+            ++extra;
+        return;
     }
+
+    word |= bit;
+    ++mWalkVersions[type];
+
+    if (type == BLOCKTYPE_WALL && mClusterGraph)
+        mClusterGraph->tileChanged(x, y);
 }
 
 void Map::freeTile(int x, int y, BlockType type)
@@ -167,27 +261,29 @@ void Map::freeTile(int x, int y, BlockType type)
     if (type == BLOCKTYPE_NONE || !contains(x, y))
         return;
 
-    MetaTile &metaTile = mMetaTiles[x + y * mWidth];
-    assert(metaTile.occupation[type] > 0);
+    uint64_t &word = mBlockPlanes[getBlockIndex(x, y, type)];
+    const uint64_t bit = uint64_t(1) << (x & 63);
+    assert(word & bit);
 
-    if (!(--metaTile.occupation[type]))
+    std::map<int, unsigned> &extraOccupation = mExtraOccupation[type];
+    std::map<int, unsigned>::iterator it =
+            extraOccupation.find(x + y * mWidth);
+    if (it != extraOccupation.end())
     {
-        switch (type)
-        {
-            case BLOCKTYPE_WALL:
-                metaTile.blockmask &= (BLOCKMASK_WALL xor 0xff);
-                break;
-            case BLOCKTYPE_CHARACTER:
-                metaTile.blockmask &= (BLOCKMASK_CHARACTER xor 0xff);
-                break;
-            case BLOCKTYPE_MONSTER:
-                metaTile.blockmask &= (BLOCKMASK_MONSTER xor 0xff);
-                break;
-            default:
-                // nothing
-                break;
-        }
+        // Still blocked by the others
+        if (!--it->second)
+            extraOccupation.erase(it);
+        return;
     }
+
+    if (!(word & bit))
+        return;
+
+    word &= ~bit;
+    ++mWalkVersions[type];
+
+    if (type == BLOCKTYPE_WALL && mClusterGraph)
+        mClusterGraph->tileChanged(x, y);
 }
 
 bool Map::getWalk(int x, int y, char walkmask) const
@@ -197,27 +293,81 @@ bool Map::getWalk(int x, int y, char walkmask) const
         return false;
 
     // Check if the tile is walkable
-    return !(mMetaTiles[x + y * mWidth].blockmask & walkmask);
+    const uint64_t *words = &mBlockPlanes[getBlockIndex(x, y, BLOCKTYPE_WALL)];
+    uint64_t blocked = 0;
+    if (walkmask & BLOCKMASK_WALL)
+        blocked |= words[BLOCKTYPE_WALL * mRowWords];
+    if (walkmask & BLOCKMASK_CHARACTER)
+        blocked |= words[BLOCKTYPE_CHARACTER * mRowWords];
+    if (walkmask & BLOCKMASK_MONSTER)
+        blocked |= words[BLOCKTYPE_MONSTER * mRowWords];
+    return !((blocked >> (x & 63)) & 1);
+}
+
+unsigned Map::getWalkVersion(unsigned char walkmask) const
+{
+    // Each version only grows, so their sum only stays the same when none
+    // of them changed.
+    unsigned version = 0;
+    for (unsigned i = 0; i < NB_BLOCKTYPES; ++i)
+    {
+        if (walkmask & blockMask(BlockType(i)))
+            version += mWalkVersions[i];
+    }
+    return version;
 }
 
 Path Map::findPath(int startX, int startY,
                    int destX, int destY,
-                   unsigned char walkmask, int maxCost) const
+                   unsigned char walkmask, int maxCost,
+                   PathAlgorithm algorithm) const
 {
+    if (algorithm == PATH_DEFAULT)
+        algorithm = getDefaultPathAlgorithm();
+
+    if (algorithm == PATH_JUMP_POINT)
+        return ::findPath.jumpPoint(startX, startY,
+                                    destX, destY,
+                                    walkmask, maxCost,
+                                    this);
+
     return ::findPath(startX, startY,
                       destX, destY,
                       walkmask, maxCost,
                       this);
 }
 
+PathAlgorithm Map::getDefaultPathAlgorithm()
+{
+    return pathFinderOption.get() == "jps" ? PATH_JUMP_POINT : PATH_ASTAR;
+}
+
+Map *Map::copyWalkability() const
+{
+    Map *copy = new Map(mWidth, mHeight, mTileWidth, mTileHeight);
+    copy->mBlockPlanes = mBlockPlanes;
+    return copy;
+}
+
+void Map::buildClusterGraph(int clusterSize)
+{
+    delete mClusterGraph;
+    mClusterGraph = new ClusterGraph(this, clusterSize);
+}
+
+Route Map::findRoute(int startX, int startY, int destX, int destY)
+{
+    if (!mClusterGraph)
+        return Route();
+
+    return mClusterGraph->findRoute(startX, startY, destX, destY);
+}
+
 Path FindPath::operator() (int startX, int startY,
                            int destX, int destY,
                            unsigned char walkmask, int maxCost,
                            const Map *map)
 {
-    // Basic cost for moving from one tile to another.
-    static int const basicCost = 100;
-
     // Path to be built up (empty by default)
     Path path;
 
@@ -286,23 +436,10 @@ Path FindPath::operator() (int startX, int startY,
                         continue;
                 }
 
-                // Calculate G cost for this route, ~sqrt(2) for moving diagonal
+                // Calculate G cost for this route, ~sqrt(2) for moving
+                // diagonal, with horizontal and vertical directions demoted.
                 int Gcost = currInfo->Gcost +
-                    (dx == 0 || dy == 0 ? basicCost : basicCost * 362 / 256);
-
-                /* Demote an arbitrary direction to speed pathfinding by
-                   adding a defect (TODO: change depending on the desired
-                   visual effect, e.g. a cross-product defect toward
-                   destination).
-                   Important: as long as the total defect along any path is
-                   less than the basicCost, the pathfinder will still find one
-                   of the shortest paths! */
-                if (dx == 0 || dy == 0)
-                {
-                    // Demote horizontal and vertical directions, so that two
-                    // consecutive directions cannot have the same Fcost.
-                    ++Gcost;
-                }
+                    (dx == 0 || dy == 0 ? straightCost : diagonalCost);
 
                 // Skip if Gcost becomes too much
                 // Warning: probably not entirely accurate
@@ -319,7 +456,7 @@ Path FindPath::operator() (int startX, int startY,
                        forbidden here. */
                     int dx = std::abs(x - destX), dy = std::abs(y - destY);
                     newTile->Hcost = std::abs(dx - dy) * basicCost +
-                        std::min(dx, dy) * (basicCost * 362 / 256);
+                        std::min(dx, dy) * diagonalCost;
 
                     // Set the current tile as the parent of the new tile
                     newTile->parentX = curr.x;
@@ -405,3 +542,277 @@ void FindPath::prepare(const Map *map)
 
     mWidth = map->getWidth();
 }
+
+static inline int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+/**
+ * Scans from (x, y) in a horizontal or vertical direction, (x, y) being the
+ * first tile of the scan. Stops at the destination, or at a tile from which
+ * a neighbour blocked from the previous tile becomes reachable, since the
+ * path may need to turn there.
+ *
+ * The scan gives up once the cost of getting to a tile plus the estimated
+ * cost from there to the destination exceeds the budget. That sum never
+ * decreases along a scan, so no tile further away could be used either.
+ *
+ * @return whether such a tile was found within the budget. Then x and y are
+ *         its coordinates, and cost was increased by the cost of getting
+ *         there.
+ */
+bool FindPath::jumpStraight(int &x, int &y, int dx, int dy, int &cost,
+                            int budget) const
+{
+    for (;;)
+    {
+        if (!walkable(x, y))
+            return false;
+
+        cost += straightCost;
+        if (cost + heuristic(x, y) > budget)
+            return false;
+
+        if (x == mDestX && y == mDestY)
+            return true;
+
+        if (dx)
+        {
+            if ((walkable(x, y - 1) && !walkable(x - dx, y - 1)) ||
+                (walkable(x, y + 1) && !walkable(x - dx, y + 1)))
+                return true;
+        }
+        else
+        {
+            if ((walkable(x - 1, y) && !walkable(x - 1, y - dy)) ||
+                (walkable(x + 1, y) && !walkable(x + 1, y - dy)))
+                return true;
+        }
+
+        x += dx;
+        y += dy;
+    }
+}
+
+/**
+ * Scans from (x, y) in a diagonal direction, (x, y) being the first tile of
+ * the scan. Stops at the destination, or at a tile from which a horizontal
+ * or vertical scan finds a place to turn. Diagonal steps may not cut
+ * corners.
+ */
+bool FindPath::jumpDiagonal(int &x, int &y, int dx, int dy, int &cost,
+                            int budget) const
+{
+    for (;;)
+    {
+        if (!walkable(x, y))
+            return false;
+
+        cost += diagonalCost;
+        if (cost + heuristic(x, y) > budget)
+            return false;
+
+        if (x == mDestX && y == mDestY)
+            return true;
+
+        int scanX = x + dx, scanY = y, scanCost = cost;
+        if (jumpStraight(scanX, scanY, dx, 0, scanCost, budget))
+            return true;
+
+        scanX = x, scanY = y + dy, scanCost = cost;
+        if (jumpStraight(scanX, scanY, 0, dy, scanCost, budget))
+            return true;
+
+        if (!walkable(x + dx, y) || !walkable(x, y + dy))
+            return false;
+
+        x += dx;
+        y += dy;
+    }
+}
+
+/**
+ * Looks for the next jump point from the current tile in the given direction
+ * and adds it to the open list.
+ */
+void FindPath::addJumpPoint(int dx, int dy, int Gcost, int budget)
+{
+    int x = mCurrX + dx, y = mCurrY + dy, cost = 0;
+    const bool found = dx && dy ? jumpDiagonal(x, y, dx, dy, cost, budget)
+                                : jumpStraight(x, y, dx, dy, cost, budget);
+    if (!found)
+        return;
+
+    PathInfo *info = getInfo(x, y);
+    if (info->whichList == mOnClosedList)
+        return;
+
+    Gcost += cost;
+
+    if (info->whichList != mOnOpenList)
+    {
+        info->Hcost = heuristic(x, y);
+    }
+    else if (Gcost >= info->Gcost)
+    {
+        return;
+    }
+
+    info->whichList = mOnOpenList;
+    info->Gcost = Gcost;
+    info->parentX = mCurrX;
+    info->parentY = mCurrY;
+    mOpenList.push(Location(x, y, Gcost + info->Hcost));
+}
+
+Path FindPath::jumpPoint(int startX, int startY,
+                         int destX, int destY,
+                         unsigned char walkmask, int maxCost,
+                         const Map *map)
+{
+    Path path;
+
+    // Return when destination not walkable
+    if (!map->getWalk(destX, destY, walkmask))
+        return path;
+
+    prepare(map);
+
+    mMap = map;
+    mWalkmask = walkmask;
+    mDestX = destX;
+    mDestY = destY;
+
+    while (!mOpenList.empty())
+        mOpenList.pop();
+
+    PathInfo *startTile = getInfo(startX, startY);
+    startTile->Gcost = 0;
+    startTile->whichList = mOnOpenList;
+    mOpenList.push(Location(startX, startY, 0));
+
+    const int maxGcost = maxCost * basicCost;
+    bool foundPath = false;
+
+    while (!mOpenList.empty())
+    {
+        const Location curr = mOpenList.top();
+        mOpenList.pop();
+        PathInfo *currInfo = getInfo(curr.x, curr.y);
+
+        if (currInfo->whichList == mOnClosedList)
+            continue;
+
+        currInfo->whichList = mOnClosedList;
+
+        if (curr.x == destX && curr.y == destY)
+        {
+            foundPath = true;
+            break;
+        }
+
+        mCurrX = curr.x;
+        mCurrY = curr.y;
+        const int Gcost = currInfo->Gcost;
+        const int budget = maxGcost - Gcost;
+        const int x = curr.x, y = curr.y;
+
+        if (x == startX && y == startY)
+        {
+            // Every direction is open from the start
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    if (dx == 0 && dy == 0)
+                        continue;
+                    if (dx != 0 && dy != 0 &&
+                        (!walkable(x + dx, y) || !walkable(x, y + dy)))
+                        continue;
+                    addJumpPoint(dx, dy, Gcost, budget);
+                }
+            }
+            continue;
+        }
+
+        // Otherwise only the directions that can lead to a shorter path than
+        // going through the parent of the tile are looked at.
+        const int dx = sign(x - currInfo->parentX);
+        const int dy = sign(y - currInfo->parentY);
+
+        if (dx && dy)
+        {
+            const bool horizontal = walkable(x + dx, y);
+            const bool vertical = walkable(x, y + dy);
+            if (vertical)
+                addJumpPoint(0, dy, Gcost, budget);
+            if (horizontal)
+                addJumpPoint(dx, 0, Gcost, budget);
+            if (horizontal && vertical)
+                addJumpPoint(dx, dy, Gcost, budget);
+        }
+        else if (dx)
+        {
+            const bool next = walkable(x + dx, y);
+            const bool up = walkable(x, y - 1);
+            const bool down = walkable(x, y + 1);
+            if (next)
+            {
+                addJumpPoint(dx, 0, Gcost, budget);
+                if (up)
+                    addJumpPoint(dx, -1, Gcost, budget);
+                if (down)
+                    addJumpPoint(dx, 1, Gcost, budget);
+            }
+            if (up)
+                addJumpPoint(0, -1, Gcost, budget);
+            if (down)
+                addJumpPoint(0, 1, Gcost, budget);
+        }
+        else
+        {
+            const bool next = walkable(x, y + dy);
+            const bool left = walkable(x - 1, y);
+            const bool right = walkable(x + 1, y);
+            if (next)
+            {
+                addJumpPoint(0, dy, Gcost, budget);
+                if (left)
+                    addJumpPoint(-1, dy, Gcost, budget);
+                if (right)
+                    addJumpPoint(1, dy, Gcost, budget);
+            }
+            if (left)
+                addJumpPoint(-1, 0, Gcost, budget);
+            if (right)
+                addJumpPoint(1, 0, Gcost, budget);
+        }
+    }
+
+    // If a path has been found, iterate backwards through the jump points,
+    // adding every tile in between.
+    if (foundPath)
+    {
+        int pathX = destX;
+        int pathY = destY;
+
+        while (pathX != startX || pathY != startY)
+        {
+            PathInfo *tile = getInfo(pathX, pathY);
+            const int parentX = tile->parentX;
+            const int parentY = tile->parentY;
+            const int dx = sign(parentX - pathX);
+            const int dy = sign(parentY - pathY);
+
+            while (pathX != parentX || pathY != parentY)
+            {
+                path.push_front(Point(pathX, pathY));
+                pathX += dx;
+                pathY += dy;
+            }
+        }
+    }
+
+    return path;
+}
@@ -21,6 +21,7 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <cstdint>
 #include <list>
 #include <map>
 #include <string>
@@ -32,32 +33,40 @@
 
 typedef std::list<Point> Path;
 
-enum BlockType
+class ClusterGraph;
+
+/**
+ * A tile to walk through on the way to a distant destination.
+ */
+struct Waypoint
 {
-    BLOCKTYPE_NONE = -1,
-    BLOCKTYPE_WALL,
-    BLOCKTYPE_CHARACTER,
-    BLOCKTYPE_MONSTER,
-    NB_BLOCKTYPES
+    Waypoint(const Point &tile, int maxCost):
+        tile(tile), maxCost(maxCost)
+    {}
+
+    Point tile;
+    int maxCost;    /**< Cost from the previous waypoint, for findPath. */
 };
 
+typedef std::list<Waypoint> Route;
+
 /**
- * A meta tile stores additional information about a location on a tile map.
- * This is information that doesn't need to be repeated for each tile in each
- * layer of the map.
+ * The algorithms Map::findPath can use.
  */
-class MetaTile
+enum PathAlgorithm
 {
-    public:
-        MetaTile()
-            : blockmask(0)
-        {
-            for (unsigned i = 0; i < NB_BLOCKTYPES; ++i)
-                occupation[i] = 0;
-        }
+    PATH_DEFAULT,       /**< As set by the game_pathFinder option. */
+    PATH_ASTAR,         /**< A* search through every tile. */
+    PATH_JUMP_POINT     /**< Jump Point Search, skipping over open tiles. */
+};
 
-        unsigned occupation[NB_BLOCKTYPES];
-        char blockmask;          /**< walkability bitfield */
+enum BlockType
+{
+    BLOCKTYPE_NONE = -1,
+    BLOCKTYPE_WALL,
+    BLOCKTYPE_CHARACTER,
+    BLOCKTYPE_MONSTER,
+    NB_BLOCKTYPES
 };
 
 class MapObject
@@ -140,6 +149,13 @@ class Map
          */
         bool getWalk(int x, int y, char walkmask = BLOCKMASK_WALL) const;
 
+        /**
+         * Returns a number that changes whenever a tile becomes blocked or
+         * free for the given blocking bitmask. A path that was walkable stays
+         * walkable as long as this number stays the same.
+         */
+        unsigned getWalkVersion(unsigned char walkmask) const;
+
         /**
          * Tells if a tile location is within the map range.
          */
@@ -194,12 +210,49 @@ class Map
         { return mMapObjects; }
 
         /**
-         * Find a path from one location to the next.
+         * Find a path from one location to the next. All the algorithms
+         * find paths of the same cost, but may choose different ones among
+         * the paths of that cost.
          */
         Path findPath(int startX, int startY,
                       int destX, int destY,
                       unsigned char walkmask,
-                      int maxCost = 20) const;
+                      int maxCost = 20,
+                      PathAlgorithm algorithm = PATH_DEFAULT) const;
+
+        /**
+         * Returns the algorithm used by findPath when none is asked for.
+         */
+        static PathAlgorithm getDefaultPathAlgorithm();
+
+        /**
+         * Returns a copy of the walkability of the map, which paths can be
+         * looked for in on another thread while this map changes. The copy
+         * has no properties, objects nor cluster graph.
+         */
+        Map *copyWalkability() const;
+
+        /**
+         * Divides the map into clusters of the given size in tiles, and
+         * builds the graph of the entrances between them used by findRoute.
+         */
+        void buildClusterGraph(int clusterSize);
+
+        /**
+         * Returns the graph built by buildClusterGraph, if any.
+         */
+        const ClusterGraph *getClusterGraph() const
+        { return mClusterGraph; }
+
+        /**
+         * Finds a route to a location of any distance, taking only walls
+         * into account. Each leg of the route, until the destination which
+         * is its last waypoint, can then be found with findPath.
+         *
+         * Returns an empty route when there is none or when no cluster graph
+         * was built.
+         */
+        Route findRoute(int startX, int startY, int destX, int destY);
 
         /**
          * Blockmasks for different entities
@@ -214,8 +267,32 @@ class Map
         int mTileWidth, mTileHeight;
         std::map<std::string, std::string> mProperties;
 
-        std::vector<MetaTile> mMetaTiles;
+        /**
+         * Returns the index of the word of mBlockPlanes holding the bit of
+         * the given tile for the given block type.
+         */
+        int getBlockIndex(int x, int y, BlockType type) const
+        { return (y * NB_BLOCKTYPES + type) * mRowWords + (x >> 6); }
+
+        /**
+         * The tiles blocked by each block type, one bit per tile. Each row of
+         * tiles is padded to whole 64-bit words, and the rows of the block
+         * types for the same y follow each other.
+         */
+        int mRowWords;
+        std::vector<uint64_t> mBlockPlanes;
+
+        /**
+         * Number of times each tile was blocked by a block type in addition
+         * to the first time, for the few tiles where things pile up.
+         */
+        std::map<int, unsigned> mExtraOccupation[NB_BLOCKTYPES];
+
+        /** Number of changes to the blocked tiles of each block type. */
+        unsigned mWalkVersions[NB_BLOCKTYPES];
+
         std::vector<MapObject*> mMapObjects;
+        ClusterGraph *mClusterGraph;
 };
 
 #endif
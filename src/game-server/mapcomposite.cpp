@@ -21,17 +21,22 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 
 #include "accountconnection.h"
 #include "common/configuration.h"
 #include "common/resourcemanager.h"
 #include "game-server/charactercomponent.h"
+#include "game-server/clustergraph.h"
+#include "game-server/collisiondetection.h"
+#include "game-server/flowfield.h"
 #include "game-server/mapcomposite.h"
 #include "game-server/map.h"
 #include "game-server/mapmanager.h"
 #include "game-server/mapreader.h"
 #include "game-server/monstermanager.h"
 #include "game-server/spawnareacomponent.h"
+#include "game-server/state.h"
 #include "game-server/triggerareacomponent.h"
 #include "scripting/script.h"
 #include "scripting/scriptmanager.h"
@@ -142,13 +147,30 @@ bool ObjectBucket::isAllocated(int i) const
    tick. It requires storing the zone in the actor since it will not be
    uniquely defined any longer. */
 
-/* Pixel-based width and height of the squares used in partitioning the map.
+/* Pixel-based width and height of the squares used in partitioning the map,
+   when neither the map nor the configuration choose another size.
    Squares should be big enough so that an actor cannot cross several ones
-   in one world tick.
-   TODO: Tune for decreasing server load. The higher the value, the closer we
-   regress to quadratic behavior; the lower the value, the more we waste time
-   in dealing with zone changes. */
-static int const zoneDiam = 256;
+   in one world tick. The higher the value, the closer we regress to quadratic
+   behavior; the lower the value, the more we waste time in dealing with zone
+   changes and visiting empty zones. */
+static int const defaultZoneDiam = 256;
+
+/* Bounds of the zone size chosen automatically from the density of the map. */
+static int const minZoneDiam = 128;
+static int const maxZoneDiam = 1024;
+
+/* Number of beings per zone aimed at when choosing the zone size. */
+static int const beingsPerZone = 8;
+
+/* Zone size of the maps, or 0 to choose it from the density of each map.
+   Maps can override it with their "zoneSize" property. */
+static Configuration::IntOption zoneSizeOption("game_zoneSize",
+                                               defaultZoneDiam);
+
+/* Size in tiles of the clusters used for planning long routes, or 0 to only
+   ever look for paths tile by tile. */
+static Configuration::IntOption pathClusterSizeOption("game_pathClusterSize",
+                                                      16);
 
 /**
  * Part of a map.
@@ -168,13 +190,46 @@ struct MapZone
      * This is necessary in order to have an accurate iterator around moving
      * objects.
      */
-    MapRegion destinations;
+    std::vector< unsigned > destinations;
+
+    /**
+     * Objects of this zone that changed during the current tick.
+     * Filled by MapComposite::collectChangedActors.
+     */
+    std::vector< Entity * > changedActors;
 
     MapZone(): nbCharacters(0), nbMovingObjects(0) {}
     void insert(Entity *);
     void remove(Entity *);
+
+    private:
+        void set(unsigned pos, Entity *);
+        void move(unsigned from, unsigned to);
+        void append(Entity *);
 };
 
+/**
+ * Puts an object at the given position of the zone and lets it know where it
+ * is, so that it can be removed without a search.
+ */
+void MapZone::set(unsigned pos, Entity *obj)
+{
+    objects[pos] = obj;
+    obj->getComponent<ActorComponent>()->setZoneSlot(pos);
+}
+
+void MapZone::move(unsigned from, unsigned to)
+{
+    if (from != to)
+        set(to, objects[from]);
+}
+
+void MapZone::append(Entity *obj)
+{
+    obj->getComponent<ActorComponent>()->setZoneSlot(objects.size());
+    objects.push_back(obj);
+}
+
 void MapZone::insert(Entity *obj)
 {
     int type = obj->getType();
@@ -186,14 +241,14 @@ void MapZone::insert(Entity *obj)
             {
                 if (nbMovingObjects != objects.size())
                 {
-                    objects.push_back(objects[nbMovingObjects]);
-                    objects[nbMovingObjects] = objects[nbCharacters];
+                    append(objects[nbMovingObjects]);
+                    set(nbMovingObjects, objects[nbCharacters]);
                 }
                 else
                 {
-                    objects.push_back(objects[nbCharacters]);
+                    append(objects[nbCharacters]);
                 }
-                objects[nbCharacters] = obj;
+                set(nbCharacters, obj);
                 ++nbCharacters;
                 ++nbMovingObjects;
                 break;
@@ -205,8 +260,8 @@ void MapZone::insert(Entity *obj)
         {
             if (nbMovingObjects != objects.size())
             {
-                objects.push_back(objects[nbMovingObjects]);
-                objects[nbMovingObjects] = obj;
+                append(objects[nbMovingObjects]);
+                set(nbMovingObjects, obj);
                 ++nbMovingObjects;
                 break;
             }
@@ -214,7 +269,7 @@ void MapZone::insert(Entity *obj)
         } // no break!
         default:
         {
-            objects.push_back(obj);
+            append(obj);
             break;
         }
     }
@@ -222,44 +277,24 @@ void MapZone::insert(Entity *obj)
 
 void MapZone::remove(Entity *obj)
 {
-    std::vector< Entity * >::iterator i_beg = objects.begin(), i, i_end;
-    int type = obj->getType();
-    switch (type)
-    {
-        case OBJECT_CHARACTER:
-        {
-            i = i_beg;
-            i_end = objects.begin() + nbCharacters;
-        } break;
-        case OBJECT_MONSTER:
-        case OBJECT_NPC:
-        {
-            i = objects.begin() + nbCharacters;
-            i_end = objects.begin() + nbMovingObjects;
-        } break;
-        default:
-        {
-            i = objects.begin() + nbMovingObjects;
-            i_end = objects.end();
-            break;
-        }
-    }
-    i = std::find(i, i_end, obj);
-    assert(i != i_end);
-    unsigned pos = i - i_beg;
+    unsigned pos = obj->getComponent<ActorComponent>()->getZoneSlot();
+    assert(pos < objects.size() && objects[pos] == obj);
+
+    // Fill the hole with the last object of each partition in turn, so that
+    // characters stay first and moving objects second.
     if (pos < nbCharacters)
     {
-        objects[pos] = objects[nbCharacters - 1];
+        move(nbCharacters - 1, pos);
         pos = nbCharacters - 1;
         --nbCharacters;
     }
     if (pos < nbMovingObjects)
     {
-        objects[pos] = objects[nbMovingObjects - 1];
+        move(nbMovingObjects - 1, pos);
         pos = nbMovingObjects - 1;
         --nbMovingObjects;
     }
-    objects[pos] = objects[objects.size() - 1];
+    move(objects.size() - 1, pos);
     objects.pop_back();
 }
 
@@ -272,9 +307,14 @@ void MapZone::remove(Entity *obj)
  */
 struct MapContent
 {
-    MapContent(Map *);
+    MapContent(Map *, int zoneDiam);
     ~MapContent();
 
+    /**
+     * Replaces the zones by empty zones of the given size.
+     */
+    void resetZones(const Map *, int zoneDiam);
+
     /**
      * Allocates a unique ID for an actor on this map.
      */
@@ -297,6 +337,21 @@ struct MapContent
      */
     void fillRegion(MapRegion &, const Rectangle &) const;
 
+    /**
+     * Makes a region cover the entire map.
+     */
+    void fillWholeMap(MapRegion &) const;
+
+    /**
+     * Adds a rectangle of zones to a region. Bounds are included.
+     */
+    void addRectangle(MapRegion &, int ax, int ay, int bx, int by) const;
+
+    /**
+     * Adds a single zone to a region.
+     */
+    void addZone(MapRegion &, unsigned zone) const;
+
     /**
      * Gets zone at given position.
      */
@@ -319,11 +374,12 @@ struct MapContent
      */
     MapZone *zones;
 
+    int zoneDiam;             /**< Size of the zones in pixels. */
     unsigned short mapWidth;  /**< Width with respect to zones. */
     unsigned short mapHeight; /**< Height with respect to zones. */
 };
 
-MapContent::MapContent(Map *map)
+MapContent::MapContent(Map *map, int zoneDiam)
   : last_bucket(0), zones(nullptr)
 {
     buckets[0] = new ObjectBucket;
@@ -332,6 +388,14 @@ MapContent::MapContent(Map *map)
     {
         buckets[i] = nullptr;
     }
+    resetZones(map, zoneDiam);
+}
+
+void MapContent::resetZones(const Map *map, int diam)
+{
+    delete[] zones;
+
+    zoneDiam = diam;
     mapWidth = (map->getWidth() * map->getTileWidth() + zoneDiam - 1)
                / zoneDiam;
     mapHeight = (map->getHeight() * map->getTileHeight() + zoneDiam - 1)
@@ -411,10 +475,10 @@ Entity *MapContent::findEntityById(int publicId) const
     return 0;
 }
 
-static void addZone(MapRegion &r, unsigned z)
+static void addDestination(std::vector< unsigned > &r, unsigned z)
 {
-    MapRegion::iterator i_end = r.end(),
-                        i = std::lower_bound(r.begin(), i_end, z);
+    std::vector< unsigned >::iterator i_end = r.end(),
+                                      i = std::lower_bound(r.begin(), i_end, z);
     if (i == i_end || *i != z)
     {
         r.insert(i, z);
@@ -427,28 +491,72 @@ void MapContent::fillRegion(MapRegion &r, const Point &p, int radius) const
         ay = p.y > radius ? (p.y - radius) / zoneDiam : 0,
         bx = std::min((p.x + radius) / zoneDiam, mapWidth - 1),
         by = std::min((p.y + radius) / zoneDiam, mapHeight - 1);
-    for (int y = ay; y <= by; ++y)
-    {
-        for (int x = ax; x <= bx; ++x)
-        {
-            addZone(r, x + y * mapWidth);
-        }
-    }
+    addRectangle(r, ax, ay, bx, by);
 }
 
 void MapContent::fillRegion(MapRegion &r, const Rectangle &p) const
 {
-    int ax = p.x / zoneDiam,
-        ay = p.y / zoneDiam,
+    int ax = std::max(p.x / zoneDiam, 0),
+        ay = std::max(p.y / zoneDiam, 0),
         bx = std::min((p.x + p.w) / zoneDiam, mapWidth - 1),
         by = std::min((p.y + p.h) / zoneDiam, mapHeight - 1);
-    for (int y = ay; y <= by; ++y)
+    addRectangle(r, ax, ay, bx, by);
+}
+
+void MapContent::fillWholeMap(MapRegion &r) const
+{
+    MapRegion::Span &span = r.rectangles[0];
+    span.x1 = 0;
+    span.y1 = 0;
+    span.x2 = mapWidth - 1;
+    span.y2 = mapHeight - 1;
+    r.nbRectangles = 1;
+    r.nbZones = 0;
+}
+
+void MapContent::addRectangle(MapRegion &r, int ax, int ay,
+                              int bx, int by) const
+{
+    if (ax > bx || ay > by)
+        return;
+
+    MapRegion::Span span = { (unsigned short) ax, (unsigned short) ay,
+                             (unsigned short) bx, (unsigned short) by };
+
+    for (unsigned i = 0; i < r.nbRectangles; ++i)
+        if (r.rectangles[i].contains(span))
+            return;
+
+    if (r.nbRectangles == MapRegion::MAX_RECTANGLES)
     {
-        for (int x = ax; x <= bx; ++x)
-        {
-            addZone(r, x + y * mapWidth);
-        }
+        // Grow the last rectangle to cover the new one as well
+        MapRegion::Span &last = r.rectangles[r.nbRectangles - 1];
+        last.x1 = std::min(last.x1, span.x1);
+        last.y1 = std::min(last.y1, span.y1);
+        last.x2 = std::max(last.x2, span.x2);
+        last.y2 = std::max(last.y2, span.y2);
+        return;
+    }
+
+    r.rectangles[r.nbRectangles++] = span;
+}
+
+void MapContent::addZone(MapRegion &r, unsigned z) const
+{
+    if (r.inRectangles(r.nbRectangles, z % mapWidth, z / mapWidth))
+        return;
+
+    for (unsigned i = 0; i < r.nbZones; ++i)
+        if (r.zones[i] == z)
+            return;
+
+    if (r.nbZones == MapRegion::MAX_ZONES)
+    {
+        fillWholeMap(r);
+        return;
     }
+
+    r.zones[r.nbZones++] = z;
 }
 
 MapZone& MapContent::getZone(const Point &pos) const
@@ -457,33 +565,140 @@ MapZone& MapContent::getZone(const Point &pos) const
 }
 
 
+/******************************************************************************
+ * BeingCandidates
+ *****************************************************************************/
+
+/**
+ * Positions and sizes of the beings of a region, gathered next to each other
+ * so that area queries can test them all at once.
+ */
+struct BeingCandidates
+{
+    void gather(ZoneIterator zones);
+    void addHits(unsigned nbHits, std::vector<Entity *> &result) const;
+
+    std::vector<Entity *> beings;
+    std::vector<int> x, y, size;
+    std::vector<unsigned> hits;
+};
+
+/**
+ * Each thread has its own candidates, as maps can be updated concurrently.
+ */
+static thread_local BeingCandidates beingCandidates;
+
+void BeingCandidates::gather(ZoneIterator zones)
+{
+    beings.clear();
+    x.clear();
+    y.clear();
+    size.clear();
+
+    for (; zones; ++zones)
+    {
+        const MapZone *zone = *zones;
+        for (unsigned i = 0; i < zone->nbMovingObjects; ++i)
+        {
+            Entity *being = zone->objects[i];
+            auto *actorComponent = being->getComponent<ActorComponent>();
+            const Point &pos = actorComponent->getPosition();
+            beings.push_back(being);
+            x.push_back(pos.x);
+            y.push_back(pos.y);
+            size.push_back(actorComponent->getSize());
+        }
+    }
+
+    hits.resize(beings.size());
+}
+
+void BeingCandidates::addHits(unsigned nbHits,
+                              std::vector<Entity *> &result) const
+{
+    for (unsigned i = 0; i < nbHits; ++i)
+        result.push_back(beings[hits[i]]);
+}
+
+
 /******************************************************************************
  * ZoneIterator
  *****************************************************************************/
 
 ZoneIterator::ZoneIterator(const MapRegion &r, const MapContent *m)
-  : region(r), pos(0), map(m)
+  : region(r), rectangle(0), x(0), y(0), pos(0), current(nullptr), map(m)
 {
-    current = &map->zones[r.empty() ? 0 : r[0]];
+    if (region.nbRectangles)
+    {
+        x = region.rectangles[0].x1;
+        y = region.rectangles[0].y1;
+    }
+    seek();
 }
 
-void ZoneIterator::operator++()
+/**
+ * Makes the zone at the current position the current zone, or the next one
+ * when it was already visited as part of a previous rectangle.
+ */
+void ZoneIterator::seek()
 {
-    current = nullptr;
-    if (!region.empty())
+    while (rectangle < region.nbRectangles)
     {
-        if (++pos != region.size())
+        const MapRegion::Span &span = region.rectangles[rectangle];
+        if (y > span.y2)
+        {
+            if (++rectangle < region.nbRectangles)
+            {
+                x = region.rectangles[rectangle].x1;
+                y = region.rectangles[rectangle].y1;
+            }
+            continue;
+        }
+
+        if (!region.inRectangles(rectangle, x, y))
+        {
+            current = &map->zones[x + y * map->mapWidth];
+            return;
+        }
+
+        if (++x > span.x2)
         {
-            current = &map->zones[region[pos]];
+            x = span.x1;
+            ++y;
         }
     }
-    else
+
+    while (pos < region.nbZones)
     {
-        if (++pos != (unsigned)map->mapWidth * map->mapHeight)
+        const unsigned zone = region.zones[pos];
+        if (!region.inRectangles(region.nbRectangles, zone % map->mapWidth,
+                                 zone / map->mapWidth))
         {
-            current = &map->zones[pos];
+            current = &map->zones[zone];
+            return;
         }
+        ++pos;
     }
+
+    current = nullptr;
+}
+
+void ZoneIterator::operator++()
+{
+    if (rectangle < region.nbRectangles)
+    {
+        const MapRegion::Span &span = region.rectangles[rectangle];
+        if (++x > span.x2)
+        {
+            x = span.x1;
+            ++y;
+        }
+    }
+    else
+    {
+        ++pos;
+    }
+    seek();
 }
 
 CharacterIterator::CharacterIterator(const ZoneIterator &it)
@@ -582,6 +797,29 @@ void ActorIterator::operator++()
     }
 }
 
+ChangedActorIterator::ChangedActorIterator(const ZoneIterator &it)
+  : iterator(it), pos(0)
+{
+    while (iterator && (*iterator)->changedActors.empty()) ++iterator;
+    if (iterator)
+    {
+        current = (*iterator)->changedActors[pos];
+    }
+}
+
+void ChangedActorIterator::operator++()
+{
+    if (++pos == (*iterator)->changedActors.size())
+    {
+        do ++iterator; while (iterator && (*iterator)->changedActors.empty());
+        pos = 0;
+    }
+    if (iterator)
+    {
+        current = (*iterator)->changedActors[pos];
+    }
+}
+
 
 /******************************************************************************
  * MapComposite
@@ -594,6 +832,7 @@ MapComposite::MapComposite(int id, const std::string &name):
     mActive(false),
     mMap(0),
     mContent(0),
+    mFlowFields(0),
     mName(name),
     mID(id),
     mPvPRules(PVP_NONE)
@@ -602,6 +841,7 @@ MapComposite::MapComposite(int id, const std::string &name):
 
 MapComposite::~MapComposite()
 {
+    delete mFlowFields;
     delete mMap;
     delete mContent;
 }
@@ -622,6 +862,16 @@ bool MapComposite::activate()
         return false;
 
     initializeContent();
+    mFlowFields = new FlowFields(mMap);
+
+    const int clusterSize = pathClusterSizeOption;
+    if (clusterSize > 0)
+    {
+        mMap->buildClusterGraph(clusterSize);
+        LOG_DEBUG("Map " << mName << " has "
+                  << mMap->getClusterGraph()->getNodeCount()
+                  << " cluster entrance nodes.");
+    }
 
     std::string sPvP = mMap->getProperty("pvp");
     if (sPvP.empty())
@@ -648,6 +898,13 @@ bool MapComposite::activate()
     return true;
 }
 
+ZoneIterator MapComposite::getWholeMapIterator() const
+{
+    MapRegion r;
+    mContent->fillWholeMap(r);
+    return ZoneIterator(r, mContent);
+}
+
 ZoneIterator MapComposite::getAroundPointIterator(const Point &p, int radius) const
 {
     MapRegion r;
@@ -672,31 +929,71 @@ ZoneIterator MapComposite::getInsideRectangleIterator(const Rectangle &p) const
 
 ZoneIterator MapComposite::getAroundBeingIterator(Entity *obj, int radius) const
 {
-    MapRegion r1;
-    mContent->fillRegion(r1,
+    MapRegion oldRegion;
+    mContent->fillRegion(oldRegion,
                          obj->getComponent<BeingComponent>()->getOldPosition(),
                          radius);
-    MapRegion r2 = r1;
-    for (MapRegion::iterator i = r1.begin(), i_end = r1.end(); i != i_end; ++i)
+
+    MapRegion r = oldRegion;
+    mContent->fillRegion(r,
+                         obj->getComponent<ActorComponent>()->getPosition(),
+                         radius);
+
+    /* Adds the destinations taken around the old position.
+       This is necessary to detect two moving objects changing zones at the
+       same time and at the border, and going in opposite directions (or
+       more simply to detect teleportations, if any). */
+    for (ZoneIterator i(oldRegion, mContent); i; ++i)
     {
-        /* Fills region with destinations taken around the old position.
-           This is necessary to detect two moving objects changing zones at the
-           same time and at the border, and going in opposite directions (or
-           more simply to detect teleportations, if any). */
-        MapRegion &r4 = mContent->zones[*i].destinations;
-        if (!r4.empty())
+        const std::vector< unsigned > &destinations = (*i)->destinations;
+        for (std::vector< unsigned >::const_iterator d = destinations.begin(),
+             d_end = destinations.end(); d != d_end; ++d)
         {
-            MapRegion r3;
-            r3.reserve(r2.size() + r4.size());
-            std::set_union(r2.begin(), r2.end(), r4.begin(), r4.end(),
-                           std::back_insert_iterator< MapRegion >(r3));
-            r2.swap(r3);
+            mContent->addZone(r, *d);
         }
     }
-    mContent->fillRegion(r2,
-                         obj->getComponent<ActorComponent>()->getPosition(),
-                         radius);
-    return ZoneIterator(r2, mContent);
+    return ZoneIterator(r, mContent);
+}
+
+void MapComposite::getBeingsInCircle(const Point &center, int radius,
+                                     std::vector<Entity *> &beings) const
+{
+    BeingCandidates &candidates = beingCandidates;
+    candidates.gather(getAroundPointIterator(center, radius));
+
+    const unsigned nbHits = Collision::circlesWithCircle(
+            candidates.x.data(), candidates.y.data(), candidates.size.data(),
+            candidates.beings.size(), center, radius,
+            candidates.hits.data());
+    candidates.addHits(nbHits, beings);
+}
+
+void MapComposite::getBeingsInRectangle(const Rectangle &rectangle,
+                                        std::vector<Entity *> &beings) const
+{
+    BeingCandidates &candidates = beingCandidates;
+    candidates.gather(getInsideRectangleIterator(rectangle));
+
+    const unsigned nbHits = Collision::pointsInRectangle(
+            candidates.x.data(), candidates.y.data(),
+            candidates.beings.size(), rectangle,
+            candidates.hits.data());
+    candidates.addHits(nbHits, beings);
+}
+
+void MapComposite::getBeingsInSector(const Point &center, int radius,
+                                     int halfTopAngle, int placeAngle,
+                                     std::vector<Entity *> &beings) const
+{
+    BeingCandidates &candidates = beingCandidates;
+    candidates.gather(getAroundPointIterator(center, radius));
+
+    const unsigned nbHits = Collision::disksWithCircleSector(
+            candidates.x.data(), candidates.y.data(), candidates.size.data(),
+            candidates.beings.size(), center, radius,
+            halfTopAngle, placeAngle,
+            candidates.hits.data());
+    candidates.addHits(nbHits, beings);
 }
 
 bool MapComposite::insert(Entity *ptr)
@@ -713,6 +1010,10 @@ bool MapComposite::insert(Entity *ptr)
 
     ptr->setMap(this);
     mContent->entities.push_back(ptr);
+
+    if (ptr->getType() == OBJECT_CHARACTER)
+        addPartyMember(ptr,
+                       ptr->getComponent<CharacterComponent>()->getParty());
     return true;
 }
 
@@ -727,6 +1028,10 @@ void MapComposite::remove(Entity *ptr)
         }
     }
 
+    if (ptr->getType() == OBJECT_CHARACTER)
+        removePartyMember(ptr,
+                          ptr->getComponent<CharacterComponent>()->getParty());
+
     if (ptr->isVisible())
     {
         const Point &point =
@@ -740,6 +1045,76 @@ void MapComposite::remove(Entity *ptr)
     }
 }
 
+int MapComposite::getZoneSize() const
+{
+    return mContent->zoneDiam;
+}
+
+void MapComposite::setZoneSize(int size)
+{
+    mContent->resetZones(mMap, size);
+
+    for (std::vector< Entity * >::iterator i = mContent->entities.begin(),
+         i_end = mContent->entities.end(); i != i_end; ++i)
+    {
+        Entity *entity = *i;
+        if (!entity->isVisible())
+            continue;
+
+        const Point &point =
+                entity->getComponent<ActorComponent>()->getPosition();
+        mContent->getZone(point).insert(entity);
+    }
+}
+
+const std::vector< Entity * > *MapComposite::getPartyMembers(int party) const
+{
+    std::map< int, std::vector< Entity * > >::const_iterator it =
+            mPartyMembers.find(party);
+    return it != mPartyMembers.end() ? &it->second : nullptr;
+}
+
+void MapComposite::addPartyMember(Entity *ptr, int party)
+{
+    std::vector< Entity * > &members = mPartyMembers[party];
+    members.push_back(ptr);
+    ptr->getComponent<CharacterComponent>()->setPartySlot(members.size());
+}
+
+bool MapComposite::removePartyMember(Entity *ptr, int party)
+{
+    auto *characterComponent = ptr->getComponent<CharacterComponent>();
+    const unsigned slot = characterComponent->getPartySlot();
+    if (!slot)
+        return false;
+
+    std::map< int, std::vector< Entity * > >::iterator it =
+            mPartyMembers.find(party);
+    assert(it != mPartyMembers.end());
+
+    // The last member takes the place of the removed one
+    std::vector< Entity * > &members = it->second;
+    assert(slot <= members.size() && members[slot - 1] == ptr);
+    Entity *last = members.back();
+    members[slot - 1] = last;
+    last->getComponent<CharacterComponent>()->setPartySlot(slot);
+    members.pop_back();
+    characterComponent->setPartySlot(0);
+
+    if (members.empty())
+        mPartyMembers.erase(it);
+    return true;
+}
+
+void MapComposite::partyChanged(Entity *ptr, int oldParty)
+{
+    // Characters that are not inserted yet are indexed on insertion
+    if (!removePartyMember(ptr, oldParty))
+        return;
+
+    addPartyMember(ptr, ptr->getComponent<CharacterComponent>()->getParty());
+}
+
 Entity *MapComposite::findEntityById(int publicId) const
 {
     return mContent->findEntityById(publicId);
@@ -747,12 +1122,32 @@ Entity *MapComposite::findEntityById(int publicId) const
 
 void MapComposite::update()
 {
-    // Update object status
+    // Update object status, one component type at a time. Each entity still
+    // has its components updated in the order of their types.
     const std::vector< Entity * > &entities = getEverything();
     for (std::vector< Entity * >::const_iterator it = entities.begin(),
          it_end = entities.end(); it != it_end; ++it)
     {
-        (*it)->update();
+        for (int type = 0; type < ComponentTypeCount; ++type)
+        {
+            ComponentType componentType = static_cast< ComponentType >(type);
+            if (Component *component = (*it)->getComponent(componentType))
+                mComponentUpdates[type].push_back(std::make_pair(component,
+                                                                 *it));
+        }
+    }
+
+    for (int type = 0; type < ComponentTypeCount; ++type)
+    {
+        std::vector< std::pair< Component *, Entity * > > &components =
+                mComponentUpdates[type];
+        for (std::vector< std::pair< Component *, Entity * > >::iterator
+             it = components.begin(), it_end = components.end();
+             it != it_end; ++it)
+        {
+            it->first->update(*it->second);
+        }
+        components.clear();
     }
 
     if (mUpdateCallback.isValid())
@@ -762,7 +1157,10 @@ void MapComposite::update()
         s->push(mID);
         s->execute(this);
     }
+}
 
+void MapComposite::updateMovement()
+{
     // Move objects around and update zones.
     for (BeingIterator it(getWholeMapIterator()); it; ++it)
     {
@@ -790,13 +1188,48 @@ void MapComposite::update()
                 &dst = mContent->getZone(pos2);
         if (&src != &dst)
         {
-            addZone(src.destinations, &dst - mContent->zones);
+            addDestination(src.destinations, &dst - mContent->zones);
             src.remove(*i);
             dst.insert(*i);
         }
     }
 }
 
+/**
+ * Returns whether players that did not move need to be told about the given
+ * actor during this tick.
+ */
+static bool hasChanged(Entity *obj)
+{
+    auto *actorComponent = obj->getComponent<ActorComponent>();
+    if (actorComponent->getUpdateFlags())
+        return true;
+
+    if (!obj->canMove())
+        return false;
+
+    auto *beingComponent = obj->getComponent<BeingComponent>();
+    if (beingComponent->getOldPosition() != actorComponent->getPosition())
+        return true;
+
+    return obj->canFight() && !beingComponent->getHitsTaken().empty();
+}
+
+void MapComposite::collectChangedActors()
+{
+    for (int i = 0; i < mContent->mapHeight * mContent->mapWidth; ++i)
+    {
+        MapZone &zone = mContent->zones[i];
+        zone.changedActors.clear();
+        for (std::vector< Entity * >::const_iterator j = zone.objects.begin(),
+             j_end = zone.objects.end(); j != j_end; ++j)
+        {
+            if (hasChanged(*j))
+                zone.changedActors.push_back(*j);
+        }
+    }
+}
+
 const std::vector< Entity * > &MapComposite::getEverything() const
 {
     return mContent->entities;
@@ -881,16 +1314,70 @@ const MapObject *MapComposite::findMapObject(const std::string &name,
     return 0; // nothing found
 }
 
+/**
+ * Chooses a zone size that puts a few beings in each zone, given the number
+ * of beings expected on the map. Sparse maps get large zones, so that area
+ * queries do not visit many empty zones, and dense maps get small zones, so
+ * that they do not look at many beings out of range.
+ */
+static int chooseZoneSize(const Map *map, int expectedBeings, int visualRange)
+{
+    const int maxDiam = std::max(minZoneDiam,
+                                 std::min(maxZoneDiam, visualRange * 2));
+    if (expectedBeings <= 0)
+        return maxDiam;
+
+    const double area = double(map->getWidth() * map->getTileWidth()) *
+                        map->getHeight() * map->getTileHeight();
+    int diam = int(std::sqrt(area * beingsPerZone / expectedBeings));
+
+    // Round to whole tiles
+    const int tileWidth = std::max(map->getTileWidth(), 1);
+    diam = (diam + tileWidth / 2) / tileWidth * tileWidth;
+
+    return std::max(minZoneDiam, std::min(diam, maxDiam));
+}
+
 /**
  * Initializes the map content. This creates the warps, spawn areas, npcs and
  * other scripts.
  */
 void MapComposite::initializeContent()
 {
-    mContent = new MapContent(mMap);
-
     const std::vector<MapObject *> &objects = mMap->getObjects();
 
+    int zoneSize = zoneSizeOption;
+    const std::string zoneSizeProperty = mMap->getProperty("zoneSize");
+    if (!zoneSizeProperty.empty())
+    {
+        zoneSize = utils::compareStrI(zoneSizeProperty, "auto") == 0 ?
+                0 : utils::stringToInt(zoneSizeProperty);
+    }
+
+    if (zoneSize <= 0)
+    {
+        int expectedBeings = 0;
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            const MapObject *object = objects.at(i);
+            if (utils::compareStrI(object->getType(), "SPAWN") == 0)
+                expectedBeings += utils::stringToInt(
+                        object->getProperty("MAX_BEINGS"));
+        }
+        zoneSize = chooseZoneSize(mMap, expectedBeings,
+                                  GameState::visualRangeOption);
+    }
+    else if (zoneSize < mMap->getTileWidth())
+    {
+        LOG_WARN("Zone size " << zoneSize << " of map " << mName
+                 << " is smaller than a tile, using " << mMap->getTileWidth()
+                 << " pixels instead.");
+        zoneSize = mMap->getTileWidth();
+    }
+
+    LOG_INFO("Map " << mName << " uses zones of " << zoneSize << " pixels.");
+    mContent = new MapContent(mMap, zoneSize);
+
     for (size_t i = 0; i < objects.size(); ++i)
     {
         const MapObject *object = objects.at(i);
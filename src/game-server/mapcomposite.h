@@ -27,9 +27,11 @@
 #include <map>
 
 #include "scripting/script.h"
+#include "game-server/component.h"
 #include "game-server/map.h"
 
 class Entity;
+class FlowFields;
 class Map;
 class Point;
 class Rectangle;
@@ -45,17 +47,65 @@ enum PvPRules
 };
 
 /**
- * Ordered sets of zones of a map.
+ * Set of zones of a map, made of up to two rectangles of zones and a few
+ * separate zones. A region is built for every area query, so it has a fixed
+ * capacity and never allocates. When it overflows it grows to a superset of
+ * the requested zones, which is fine since users of the iterators check the
+ * actual positions anyway.
  */
-typedef std::vector< unsigned > MapRegion;
+struct MapRegion
+{
+    enum
+    {
+        MAX_RECTANGLES = 2,
+        MAX_ZONES = 16
+    };
+
+    /**
+     * Rectangle of zones, in zone coordinates. Bounds are included.
+     */
+    struct Span
+    {
+        unsigned short x1, y1, x2, y2;
+
+        bool contains(unsigned short x, unsigned short y) const
+        { return x >= x1 && x <= x2 && y >= y1 && y <= y2; }
+
+        bool contains(const Span &s) const
+        { return s.x1 >= x1 && s.x2 <= x2 && s.y1 >= y1 && s.y2 <= y2; }
+    };
+
+    MapRegion(): nbRectangles(0), nbZones(0) {}
+
+    /**
+     * Returns whether one of the first \a count rectangles contains the
+     * given zone.
+     */
+    bool inRectangles(unsigned count, unsigned short x,
+                      unsigned short y) const
+    {
+        for (unsigned i = 0; i < count; ++i)
+            if (rectangles[i].contains(x, y))
+                return true;
+        return false;
+    }
+
+    Span rectangles[MAX_RECTANGLES];
+    unsigned nbRectangles;
+    unsigned zones[MAX_ZONES];  /**< Zones outside of the rectangles. */
+    unsigned nbZones;
+};
 
 /**
- * Iterates through the zones of a region of the map.
+ * Iterates through the zones of a region of the map. Each zone is visited
+ * once, even when the rectangles of the region overlap.
  */
 struct ZoneIterator
 {
-    MapRegion region; /**< Zones to visit. Empty means the entire map. */
-    unsigned pos;
+    MapRegion region;   /**< Zones to visit. */
+    unsigned rectangle; /**< Current rectangle, past the last one for zones. */
+    unsigned short x, y;
+    unsigned pos;       /**< Current separate zone. */
     MapZone *current;
     const MapContent *map;
 
@@ -63,6 +113,9 @@ struct ZoneIterator
     void operator++();
     MapZone *operator*() const { return current; }
     operator bool() const { return current; }
+
+    private:
+        void seek();
 };
 
 /**
@@ -125,6 +178,23 @@ struct ActorIterator
     operator bool() const { return iterator; }
 };
 
+/**
+ * Iterates through the Actors of a region that changed during the current
+ * tick. Only meaningful after MapComposite::collectChangedActors() has been
+ * called for this tick.
+ */
+struct ChangedActorIterator
+{
+    ZoneIterator iterator;
+    unsigned short pos;
+    Entity *current;
+
+    ChangedActorIterator(const ZoneIterator &);
+    void operator++();
+    Entity *operator*() const { return current; }
+    operator bool() const { return iterator; }
+};
+
 /**
  * Combined map/entity structure.
  */
@@ -152,6 +222,12 @@ class MapComposite
         Map *getMap() const
         { return mMap; }
 
+        /**
+         * Gets the paths shared by the beings walking to the same tile.
+         */
+        FlowFields *getFlowFields() const
+        { return mFlowFields; }
+
         /**
          * Returns whether the map is active on this server or not.
          */
@@ -187,20 +263,60 @@ class MapComposite
         Entity *findEntityById(int publicId) const;
 
         /**
-         * Updates zones of every moving beings.
+         * Gets the characters of a party that are on this map.
+         *
+         * @return the members, or null when none of them is on the map.
+         */
+        const std::vector< Entity * > *getPartyMembers(int party) const;
+
+        /**
+         * Moves a character of this map from its old party to its current
+         * one in the party index. Does nothing when the character is not
+         * inserted on the map.
+         */
+        void partyChanged(Entity *, int oldParty);
+
+        /**
+         * Updates the entities on the map and runs the map update callback.
          */
         void update();
 
+        /**
+         * Moves the beings around and updates the zones they are in. Does not
+         * run any script nor touch anything outside of the map, so that it
+         * can be called concurrently for different maps.
+         */
+        void updateMovement();
+
+        /**
+         * Records, for every zone, the actors that players around need to be
+         * informed about: the ones that moved, raised update flags or took
+         * hits during the current tick. Characters that did not move
+         * themselves only need to look at these.
+         */
+        void collectChangedActors();
+
         /**
          * Gets the PvP rules on the map.
          */
         PvPRules getPvP() const { return mPvPRules; }
 
+        /**
+         * Gets the width and height of the zones partitioning the map, in
+         * pixels.
+         */
+        int getZoneSize() const;
+
+        /**
+         * Partitions the map with zones of the given size, in pixels. Should
+         * only be called between world ticks.
+         */
+        void setZoneSize(int size);
+
         /**
          * Gets an iterator on the objects of the whole map.
          */
-        ZoneIterator getWholeMapIterator() const
-        { return ZoneIterator(MapRegion(), mContent); }
+        ZoneIterator getWholeMapIterator() const;
 
         /**
          * Gets an iterator on the objects inside a given rectangle.
@@ -223,6 +339,28 @@ class MapComposite
          */
         ZoneIterator getAroundBeingIterator(Entity *, int radius) const;
 
+        /**
+         * Adds the beings touching a circle to \a beings. The beings around
+         * are tested all at once, which is faster than iterating over them
+         * in crowded areas.
+         */
+        void getBeingsInCircle(const Point &center, int radius,
+                               std::vector<Entity *> &beings) const;
+
+        /**
+         * Adds the beings standing inside a rectangle to \a beings.
+         */
+        void getBeingsInRectangle(const Rectangle &rectangle,
+                                  std::vector<Entity *> &beings) const;
+
+        /**
+         * Adds the beings touching a circle sector to \a beings. The angles
+         * are in degrees, as for Collision::diskWithCircleSector.
+         */
+        void getBeingsInSector(const Point &center, int radius,
+                               int halfTopAngle, int placeAngle,
+                               std::vector<Entity *> &beings) const;
+
         /**
          * Gets everything related to the map.
          */
@@ -273,20 +411,37 @@ class MapComposite
 
     private:
         void initializeContent();
+        void addPartyMember(Entity *, int party);
+        bool removePartyMember(Entity *, int party);
         void callMapVariableCallback(const std::string &key,
                                      const std::string &value);
 
         bool mActive;         /**< Status of map. */
         Map *mMap;            /**< Actual map. */
         MapContent *mContent; /**< Entities on the map. */
+        FlowFields *mFlowFields;
         std::string mName;    /**< Name of the map. */
         unsigned short mID;   /**< ID of the map. */
         /** Cached persistent variables */
         std::map<std::string, std::string> mScriptVariables;
         PvPRules mPvPRules;
+        /**
+         * Characters on the map, indexed by party id. Each character knows
+         * its position in the members of its party, to be removed in
+         * constant time.
+         */
+        std::map< int, std::vector< Entity * > > mPartyMembers;
         std::map<const std::string, Script::Ref> mMapVariableCallbacks;
         std::map<const std::string, Script::Ref> mWorldVariableCallbacks;
 
+        /**
+         * Components of the entities on the map, grouped by type so that
+         * they are updated one type after the other. Only used during
+         * update(), kept to reuse the memory.
+         */
+        std::vector< std::pair< Component *, Entity * > >
+                mComponentUpdates[ComponentTypeCount];
+
         static Script::Ref mInitializeCallback;
         static Script::Ref mUpdateCallback;
 };
@@ -35,6 +35,8 @@
 
 #include <cmath>
 
+#include <sigc++/adaptors/bind.h>
+
 MonsterComponent::MonsterComponent(Entity &entity, MonsterClass *specy):
     mSpecy(specy)
 {
@@ -75,8 +77,8 @@ MonsterComponent::MonsterComponent(Entity &entity, MonsterClass *specy):
                                      attributeValue);
     }
 
-    beingComponent->setGender(specy->getGender());
-    beingComponent->setName(specy->getName());
+    beingComponent->setGender(entity, specy->getGender());
+    beingComponent->setName(entity, specy->getName());
 
     AbilityComponent *abilityComponent = new AbilityComponent();
     entity.addComponent(abilityComponent);
@@ -92,14 +94,9 @@ void MonsterComponent::update(Entity &entity)
 {
     auto *beingComponent = entity.getComponent<BeingComponent>();
 
-    // If dead, remove it
+    // Dead monsters are removed by their decay timer
     if (beingComponent->getAction() == DEAD)
-    {
-        if (mDecayTimeout.expired())
-            GameState::enqueueRemove(&entity);
-
         return;
-    }
 
     if (mSpecy->getUpdateCallback().isValid())
     {
@@ -113,6 +110,15 @@ void MonsterComponent::update(Entity &entity)
 
 void MonsterComponent::monsterDied(Entity *monster)
 {
-    mDecayTimeout.set(DECAY_TIME);
+    mDecayTimer.start(DECAY_TIME, sigc::bind(
+            sigc::mem_fun(this, &MonsterComponent::decayed), monster));
+}
+
+void MonsterComponent::decayed(Entity *monster)
+{
+    // A script may have brought the monster back in the meantime
+    auto *beingComponent = monster->getComponent<BeingComponent>();
+    if (beingComponent->getAction() == DEAD)
+        GameState::enqueueRemove(monster);
 }
 
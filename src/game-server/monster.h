@@ -23,6 +23,7 @@
 
 #include "game-server/abilitymanager.h"
 #include "game-server/being.h"
+#include "game-server/timerwheel.h"
 
 #include "common/defines.h"
 
@@ -157,7 +158,7 @@ class MonsterClass
 /**
  * The component for a fightable monster with its own AI
  */
-class MonsterComponent : public Component
+class MonsterComponent : public PooledComponent<MonsterComponent>
 {
     public:
         static const ComponentType type = CT_Monster;
@@ -183,10 +184,16 @@ class MonsterComponent : public Component
     private:
         static const int DECAY_TIME = 50;
 
+        /**
+         * Removes the monster once its decay timer fires, unless it is no
+         * longer dead.
+         */
+        void decayed(Entity *monster);
+
         MonsterClass *mSpecy;
 
-        /** Time until dead monster is removed */
-        Timeout mDecayTimeout;
+        /** Removes the dead monster after a while */
+        Timer mDecayTimer;
 };
 
 inline void MonsterClass::setAttribute(AttributeInfo *attribute, double value)
@@ -0,0 +1,237 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/movementsnapshots.h"
+
+#include "common/manaserv_protocol.h"
+#include "net/messageout.h"
+
+#include <algorithm>
+
+using namespace ManaServ;
+
+/**
+ * Tells whether a change of destination can be sent as a signed byte.
+ */
+static bool fitsInByte(int value)
+{
+    return value >= -128 && value <= 127;
+}
+
+MovementSnapshots::MovementSnapshots():
+    mSequence(0),
+    mAcknowledged(-1)
+{
+}
+
+void MovementSnapshots::clear()
+{
+    mCurrent.clear();
+    mChanges.clear();
+
+    for (unsigned i = 0; i < HISTORY_SIZE; ++i)
+        mHistory[i].valid = false;
+    mAcknowledged = -1;
+}
+
+void MovementSnapshots::update(int id, int flags, const Point &position,
+                               const Point &destination, int speed)
+{
+    if (!(flags & MOVING_DESTINATION))
+        return;
+
+    Change change;
+    change.id = id;
+    change.flags = flags;
+    change.position = position;
+    change.state.destination = destination;
+    change.state.speed = speed;
+    mChanges.push_back(change);
+}
+
+void MovementSnapshots::remove(int id)
+{
+    mCurrent.erase(id);
+}
+
+bool MovementSnapshots::getKnownState(int id, Point &destination,
+                                      int &speed) const
+{
+    std::map<int, BeingState>::const_iterator it = mCurrent.find(id);
+    if (it == mCurrent.end())
+        return false;
+
+    destination = it->second.destination;
+    speed = it->second.speed;
+    return true;
+}
+
+/**
+ * Returns the update the next one can be relative to, which is the last
+ * acknowledged one when it is still kept.
+ */
+const MovementSnapshots::Update *MovementSnapshots::getBase() const
+{
+    if (mAcknowledged < 0)
+        return nullptr;
+
+    // The slot of the next update is about to be overwritten
+    const unsigned age = (mSequence - mAcknowledged) & SEQUENCE_MASK;
+    if (age >= HISTORY_SIZE)
+        return nullptr;
+
+    const Update &update = mHistory[mAcknowledged % HISTORY_SIZE];
+    if (!update.valid || update.sequence != unsigned(mAcknowledged))
+        return nullptr;
+
+    return &update;
+}
+
+bool MovementSnapshots::write(MessageOut &msg, bool keyframe)
+{
+    // Without a base, the client starts again from nothing and every being
+    // is described in full
+    const Update *base = keyframe ? nullptr : getBase();
+
+    // Keeps the order of the changes of a being, the last one counting
+    std::stable_sort(mChanges.begin(), mChanges.end());
+    for (std::vector<Change>::const_iterator it = mChanges.begin(),
+         it_end = mChanges.end(); it != it_end; ++it)
+    {
+        mCurrent[it->id] = it->state;
+    }
+
+    Update &update = mHistory[mSequence % HISTORY_SIZE];
+    update.valid = false;
+    update.sequence = mSequence;
+    update.beings.clear();
+
+    msg.writeInt16(mSequence);
+    msg.writeInt16(base ? base->sequence : mSequence);
+
+    static const std::vector<BeingEntry> noBeings;
+    const std::vector<BeingEntry> &baseBeings =
+            base ? base->beings : noBeings;
+    std::vector<BeingEntry>::const_iterator b = baseBeings.begin(),
+                                            b_end = baseBeings.end();
+    std::vector<Change>::const_iterator c = mChanges.begin(),
+                                        c_end = mChanges.end();
+    bool written = false;
+
+    // The beings that changed since the base, from what the client knows
+    // after it
+    for (std::map<int, BeingState>::const_iterator it = mCurrent.begin(),
+         it_end = mCurrent.end(); it != it_end; ++it)
+    {
+        const int id = it->first;
+        const BeingState &state = it->second;
+
+        BeingEntry entry;
+        entry.id = id;
+        entry.state = state;
+        update.beings.push_back(entry);
+
+        while (b != b_end && b->id < id)
+            ++b;
+        while (c != c_end && c->id < id)
+            ++c;
+
+        int flags = 0;
+        int dx = 0, dy = 0;
+
+        // Several changes of the same being keep the last position check
+        const Change *change = nullptr;
+        while (c != c_end && c->id == id)
+            change = &*c++;
+        if (change && (change->flags & MOVING_POSITION))
+            flags |= MOVING_POSITION;
+
+        if (b != b_end && b->id == id)
+        {
+            dx = state.destination.x - b->state.destination.x;
+            dy = state.destination.y - b->state.destination.y;
+            if (dx != 0 || dy != 0)
+            {
+                flags |= fitsInByte(dx) && fitsInByte(dy) ?
+                        MOVING_DESTINATION_CHANGE : MOVING_DESTINATION;
+            }
+            if (state.speed != b->state.speed)
+                flags |= MOVING_SPEED;
+        }
+        else
+        {
+            flags |= MOVING_DESTINATION | MOVING_SPEED;
+        }
+
+        if (!flags)
+            continue;
+
+        msg.writeInt16(id);
+        msg.writeInt8(flags);
+        if (flags & MOVING_POSITION)
+        {
+            msg.writeInt16(change->position.x);
+            msg.writeInt16(change->position.y);
+        }
+        if (flags & MOVING_DESTINATION)
+        {
+            msg.writeInt16(state.destination.x);
+            msg.writeInt16(state.destination.y);
+        }
+        else if (flags & MOVING_DESTINATION_CHANGE)
+        {
+            msg.writeInt8(dx);
+            msg.writeInt8(dy);
+        }
+        if (flags & MOVING_SPEED)
+            msg.writeInt8(state.speed);
+
+        written = true;
+    }
+
+    mChanges.clear();
+
+    // An update without news is not sent, so it does not need a sequence
+    if (!written)
+        return false;
+
+    update.valid = true;
+    mSequence = (mSequence + 1) & SEQUENCE_MASK;
+    return true;
+}
+
+void MovementSnapshots::acknowledge(unsigned sequence)
+{
+    sequence &= SEQUENCE_MASK;
+
+    const Update &update = mHistory[sequence % HISTORY_SIZE];
+    if (!update.valid || update.sequence != sequence)
+        return;
+
+    // Only newer updates are better bases
+    if (mAcknowledged >= 0)
+    {
+        const unsigned newer = (sequence - mAcknowledged) & SEQUENCE_MASK;
+        if (newer == 0 || newer >= SEQUENCE_MASK / 2)
+            return;
+    }
+
+    mAcknowledged = sequence;
+}
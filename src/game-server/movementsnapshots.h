@@ -0,0 +1,162 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOVEMENTSNAPSHOTS_H
+#define MOVEMENTSNAPSHOTS_H
+
+#include "utils/point.h"
+
+#include <map>
+#include <vector>
+
+class MessageOut;
+
+/**
+ * The movements of the beings around a character that its client was told
+ * about, so that each GPMSG_BEINGS_MOVE_DELTA only carries what changed since
+ * an update the client acknowledged. Since the client keeps its own copy of
+ * the updates it acknowledges, the updates can be sent unreliably: a lost one
+ * is made up for by the next, which is relative to an older update.
+ *
+ * A keyframe is an update relative to nothing, sent with its own sequence as
+ * base sequence. It describes every being the client is told about in full,
+ * so that the client starts again from it alone. Updates are keyframes when
+ * asked for, and whenever no acknowledged update is left to use as base.
+ * The client keeps the updates it received recently, keyframes or not, as
+ * they may still be used as bases.
+ *
+ * A being is forgotten once it leaves the sight of the character. The client
+ * may keep it in its updates, as it is described in full should it come back
+ * before the next keyframe.
+ *
+ * Only used by the thread updating the map of the character, or by the main
+ * thread between ticks.
+ */
+class MovementSnapshots
+{
+    public:
+        MovementSnapshots();
+
+        /**
+         * Forgets all the updates, for when the character arrives on a map.
+         * The next update is a keyframe.
+         */
+        void clear();
+
+        /**
+         * Records what the client should be told about a being during this
+         * tick. Nothing is recorded without a destination.
+         *
+         * @param flags       the MOVING_POSITION and MOVING_DESTINATION
+         *                    flags, telling which points are given
+         * @param position    the position of the being, sent as a check
+         * @param destination where the client should move the being to
+         * @param speed       the speed sent in GPMSG_BEINGS_MOVE
+         */
+        void update(int id, int flags, const Point &position,
+                    const Point &destination, int speed);
+
+        /**
+         * Forgets about a being that left the sight of the character.
+         */
+        void remove(int id);
+
+        /**
+         * Gets the destination and speed of a being as known by the client
+         * once it received the last update written. Returns false when the
+         * being is not known.
+         */
+        bool getKnownState(int id, Point &destination, int &speed) const;
+
+        /**
+         * Writes the update of this tick to a GPMSG_BEINGS_MOVE_DELTA
+         * message. Returns false when there is nothing to send, in which
+         * case the update is dropped.
+         *
+         * @param keyframe whether to start again from nothing
+         */
+        bool write(MessageOut &msg, bool keyframe);
+
+        /**
+         * Handles the acknowledgment of the update with the given sequence
+         * number. Older acknowledgments than the last one are ignored.
+         */
+        void acknowledge(unsigned sequence);
+
+        /**
+         * Returns the sequence number of the last update written.
+         */
+        unsigned getLastSequence() const
+        { return (mSequence - 1) & SEQUENCE_MASK; }
+
+    private:
+        /** Number of updates kept for the acknowledgments. */
+        static const unsigned HISTORY_SIZE = 16;
+
+        static const unsigned SEQUENCE_MASK = 0xFFFF;
+
+        struct BeingState
+        {
+            Point destination;
+            int speed;
+        };
+
+        struct BeingEntry
+        {
+            int id;
+            BeingState state;
+        };
+
+        struct Change
+        {
+            bool operator<(const Change &other) const
+            { return id < other.id; }
+
+            int id;
+            int flags;
+            Point position;
+            BeingState state;
+        };
+
+        struct Update
+        {
+            Update(): valid(false) {}
+
+            bool valid;
+            unsigned sequence;
+            std::vector<BeingEntry> beings;     /**< Sorted by ID. */
+        };
+
+        const Update *getBase() const;
+
+        /**
+         * What the client knows once it has received the last update, by
+         * being ID.
+         */
+        std::map<int, BeingState> mCurrent;
+
+        std::vector<Change> mChanges;   /**< Recorded during this tick. */
+
+        Update mHistory[HISTORY_SIZE];
+        unsigned mSequence;         /**< Sequence of the next update. */
+        int mAcknowledged;          /**< Last acknowledged, -1 for none. */
+};
+
+#endif // MOVEMENTSNAPSHOTS_H
@@ -22,6 +22,7 @@
 
 #include "common/configuration.h"
 #include "game-server/accountconnection.h"
+#include "game-server/asyncpathfinder.h"
 #include "game-server/effect.h"
 #include "game-server/gamehandler.h"
 #include "game-server/inventory.h"
@@ -31,15 +32,21 @@
 #include "game-server/mapcomposite.h"
 #include "game-server/mapmanager.h"
 #include "game-server/monster.h"
+#include "game-server/movementsnapshots.h"
 #include "game-server/npc.h"
+#include "game-server/tickprofiler.h"
+#include "game-server/timerwheel.h"
 #include "game-server/trade.h"
 #include "net/messageout.h"
 #include "scripting/script.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/speedconv.h"
+#include "utils/string.h"
+#include "utils/workerpool.h"
 
 #include <cassert>
+#include <sstream>
 
 enum
 {
@@ -70,6 +77,70 @@ static int currentTick;
  */
 static DelayedEvents delayedEvents;
 
+/**
+ * Movement update rate of the beings that are further than a given distance
+ * from a character.
+ */
+struct MovementTier
+{
+    int distance;   /**< Distance in pixels from the character. */
+    int interval;   /**< Number of ticks between two movement updates. */
+};
+
+/**
+ * Movement update tiers, sorted by increasing distance. Empty when every
+ * being is updated each tick.
+ */
+static std::vector< MovementTier > movementTiers;
+
+/**
+ * Options read on every tick, kept up to date on configuration reloads.
+ */
+Configuration::IntOption GameState::visualRangeOption("game_visualRange",
+                                                   448);
+static Configuration::BoolOption deltaVisibilityOption("game_deltaVisibility",
+                                                       false);
+static Configuration::StringOption movementTiersOption(
+        "game_movementUpdateTiers", std::string());
+static Configuration::IntOption workerThreadsOption("game_workerThreads", 0);
+
+/**
+ * Whether the movement tiers were read and follow the changes of the option.
+ */
+static bool movementTiersRead = false;
+
+/**
+ * Threads updating the maps concurrently, or null when the maps are updated
+ * on the main thread.
+ */
+static utils::WorkerPool *mapWorkers;
+
+/**
+ * Active maps and the messages to their players, used while the maps are
+ * updated concurrently.
+ */
+static std::vector< MapComposite * > activeMaps;
+static std::vector< DeferredMessages > mapMessages;
+
+/**
+ * Time spent on a map during the current tick, in microseconds.
+ */
+struct MapTickTimes
+{
+    MapTickTimes():
+        update(0),
+        inform(0)
+    {}
+
+    unsigned update;    /**< Updating the entities and moving the beings. */
+    unsigned inform;    /**< Informing the players. */
+};
+
+/**
+ * Time spent on each of the active maps during the current tick.
+ */
+static std::vector< MapTickTimes > mapTimes;
+
 /**
  * Cached persistent script variables
  */
@@ -123,353 +194,615 @@ static void serializeLooks(Entity *ch, MessageOut &msg)
 }
 
 /**
- * Informs a player of what happened around the character.
+ * Reads the movement update tiers. The option is a comma separated list of
+ * "distance:interval" pairs, for instance "224:2,336:4".
  */
-static void informPlayer(MapComposite *map, Entity *p)
+static void readMovementTiers()
 {
-    MessageOut moveMsg(GPMSG_BEINGS_MOVE);
-    MessageOut damageMsg(GPMSG_BEINGS_DAMAGE);
-    const Point &pold = p->getComponent<BeingComponent>()->getOldPosition();
-    const Point &ppos = p->getComponent<ActorComponent>()->getPosition();
-    int pflags = p->getComponent<ActorComponent>()->getUpdateFlags();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    movementTiers.clear();
 
-    // Inform client about activities of other beings near its character
-    for (BeingIterator it(map->getAroundBeingIterator(p, visualRange));
-         it; ++it)
+    std::istringstream tiers(movementTiersOption.get());
+    std::string tier;
+    while (std::getline(tiers, tier, ','))
     {
-        Entity *o = *it;
-
-        const Point &oold =
-                o->getComponent<BeingComponent>()->getOldPosition();
-        const Point &opos = o->getComponent<ActorComponent>()->getPosition();
-        int otype = o->getType();
-        int oid = o->getComponent<ActorComponent>()->getPublicID();
-        int oflags = o->getComponent<ActorComponent>()->getUpdateFlags();
-        int flags = 0;
-
-        // Check if the character p and the moving object o are around.
-        bool wereInRange = pold.inRangeOf(oold, visualRange) &&
-                           !((pflags | oflags) & UPDATEFLAG_NEW_ON_MAP);
-        bool willBeInRange = ppos.inRangeOf(opos, visualRange);
-
-        if (!wereInRange && !willBeInRange)
+        std::string::size_type separator = tier.find(':');
+        if (separator == std::string::npos)
         {
-            // Nothing to report: o and p are far away from each other.
+            LOG_WARN("Invalid movement update tier \"" << tier << "\".");
             continue;
         }
 
-
-        if (wereInRange && willBeInRange)
+        MovementTier movementTier;
+        movementTier.distance = utils::stringToInt(tier.substr(0, separator));
+        movementTier.interval = utils::stringToInt(tier.substr(separator + 1));
+        if (movementTier.distance <= 0 || movementTier.interval <= 1)
         {
-            // Send action change messages.
-            if ((oflags & UPDATEFLAG_ACTIONCHANGE))
-            {
-                MessageOut actionMsg(GPMSG_BEING_ACTION_CHANGE);
-                actionMsg.writeInt16(oid);
-                actionMsg.writeInt8(
-                        o->getComponent<BeingComponent>()->getAction());
-                gameHandler->sendTo(p, actionMsg);
-            }
-
-            // Send looks change messages.
-            if (oflags & UPDATEFLAG_LOOKSCHANGE)
-            {
-                MessageOut looksMsg(GPMSG_BEING_LOOKS_CHANGE);
-                looksMsg.writeInt16(oid);
-                serializeLooks(o, looksMsg);
-                gameHandler->sendTo(p, looksMsg);
-            }
-
-            // Send emote messages.
-            if (oflags & UPDATEFLAG_EMOTE)
-            {
-                int emoteId =
-                        o->getComponent<BeingComponent>()->getLastEmote();
-                if (emoteId > -1)
-                {
-                    MessageOut emoteMsg(GPMSG_BEING_EMOTE);
-                    emoteMsg.writeInt16(oid);
-                    emoteMsg.writeInt16(emoteId);
-                    gameHandler->sendTo(p, emoteMsg);
-                }
-            }
-
-            // Send direction change messages.
-            if (oflags & UPDATEFLAG_DIRCHANGE && o != p)
-            {
-                MessageOut dirMsg(GPMSG_BEING_DIR_CHANGE);
-                dirMsg.writeInt16(oid);
-                dirMsg.writeInt8(
-                        o->getComponent<BeingComponent>()->getDirection());
-                gameHandler->sendTo(p, dirMsg);
-            }
-
-            // Send ability uses
-            if (oflags & UPDATEFLAG_ABILITY_ON_POINT)
-            {
-                MessageOut abilityMsg(GPMSG_BEING_ABILITY_POINT);
-                abilityMsg.writeInt16(oid);
-                auto *abilityComponent = o->getComponent<AbilityComponent>();
-                const Point &point = abilityComponent->getLastTargetPoint();
-                abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
-                abilityMsg.writeInt16(point.x);
-                abilityMsg.writeInt16(point.y);
-                gameHandler->sendTo(p, abilityMsg);
-            }
-
-            if (oflags & UPDATEFLAG_ABILITY_ON_BEING)
-            {
-                MessageOut abilityMsg(GPMSG_BEING_ABILITY_BEING);
-                abilityMsg.writeInt16(oid);
-                auto *abilityComponent = o->getComponent<AbilityComponent>();
-                abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
-                abilityMsg.writeInt16(
-                        abilityComponent->getLastTargetBeingId());
-                gameHandler->sendTo(p, abilityMsg);
-            }
+            LOG_WARN("Ignoring movement update tier \"" << tier << "\".");
+            continue;
+        }
 
-            if (oflags & UPDATEFLAG_ABILITY_ON_DIRECTION)
-            {
-                MessageOut abilityMsg(GPMSG_BEING_ABILITY_DIRECTION);
-                abilityMsg.writeInt16(oid);
-                auto *abilityComponent = o->getComponent<AbilityComponent>();
-                abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
-                abilityMsg.writeInt8(
-                        abilityComponent->getLastTargetDirection());
-                gameHandler->sendTo(p, abilityMsg);
-            }
+        std::vector< MovementTier >::iterator it = movementTiers.begin();
+        while (it != movementTiers.end() && it->distance < movementTier.distance)
+            ++it;
+        movementTiers.insert(it, movementTier);
+    }
+}
 
-            // Send damage messages.
-            if (o->canFight())
-            {
-                auto *beingComponent = o->getComponent<BeingComponent>();
-                const Hits &hits = beingComponent->getHitsTaken();
-                for (Hits::const_iterator j = hits.begin(),
-                     j_end = hits.end(); j != j_end; ++j)
-                {
-                    damageMsg.writeInt16(oid);
-                    damageMsg.writeInt16(*j);
-                }
-            }
+/**
+ * Gets the number of ticks between two movement updates about a being at
+ * position \a opos for a character at position \a ppos.
+ */
+static int getMovementUpdateInterval(const Point &ppos, const Point &opos)
+{
+    int interval = 1;
+    for (std::vector< MovementTier >::const_iterator it = movementTiers.begin(),
+         it_end = movementTiers.end(); it != it_end; ++it)
+    {
+        if (ppos.inRangeOf(opos, it->distance))
+            break;
+        interval = it->interval;
+    }
+    return interval;
+}
 
-            if (oold == opos)
-            {
-                // o does not move, nothing more to report.
-                continue;
-            }
-        }
+/**
+ * Gets a message about a being that is the same for every client, encoding
+ * it only the first time it is needed during the current tick.
+ */
+static MessageOut &getBeingMessage(Entity *o, ActorMessage type)
+{
+    auto *actorComponent = o->getComponent<ActorComponent>();
+    if (MessageOut *cached = actorComponent->getCachedMessage(type))
+        return *cached;
 
-        if (!willBeInRange)
-        {
-            // o is no longer visible from p. Send leave message.
-            MessageOut leaveMsg(GPMSG_BEING_LEAVE);
-            leaveMsg.writeInt16(oid);
-            gameHandler->sendTo(p, leaveMsg);
-            continue;
-        }
+    auto *beingComponent = o->getComponent<BeingComponent>();
+    int oid = actorComponent->getPublicID();
+    MessageOut *msg = nullptr;
 
-        if (!wereInRange)
+    switch (type)
+    {
+        case ACTORMSG_ENTER:
         {
-            // o is now visible by p. Send enter message.
-            MessageOut enterMsg(GPMSG_BEING_ENTER);
-            enterMsg.writeInt8(otype);
-            enterMsg.writeInt16(oid);
-            enterMsg.writeInt8(o->getComponent<BeingComponent>()->getAction());
-            enterMsg.writeInt16(opos.x);
-            enterMsg.writeInt16(opos.y);
-            enterMsg.writeInt8(
-                    o->getComponent<BeingComponent>()->getDirection());
-            enterMsg.writeInt8(o->getComponent<BeingComponent>()->getGender());
+            const Point &opos = actorComponent->getPosition();
+            int otype = o->getType();
+            msg = new MessageOut(GPMSG_BEING_ENTER);
+            msg->writeInt8(otype);
+            msg->writeInt16(oid);
+            msg->writeInt8(beingComponent->getAction());
+            msg->writeInt16(opos.x);
+            msg->writeInt16(opos.y);
+            msg->writeInt8(beingComponent->getDirection());
+            msg->writeInt8(beingComponent->getGender());
             switch (otype)
             {
                 case OBJECT_CHARACTER:
                 {
-                    enterMsg.writeString(
-                            o->getComponent<BeingComponent>()->getName());
-                    serializeLooks(o, enterMsg);
+                    msg->writeString(beingComponent->getName());
+                    serializeLooks(o, *msg);
                 } break;
 
                 case OBJECT_MONSTER:
                 {
                     MonsterComponent *monsterComponent =
                             o->getComponent<MonsterComponent>();
-                    enterMsg.writeInt16(monsterComponent->getSpecy()->getId());
-                    enterMsg.writeString(
-                            o->getComponent<BeingComponent>()->getName());
+                    msg->writeInt16(monsterComponent->getSpecy()->getId());
+                    msg->writeString(beingComponent->getName());
                 } break;
 
                 case OBJECT_NPC:
                 {
                     NpcComponent *npcComponent =
                             o->getComponent<NpcComponent>();
-                    enterMsg.writeInt16(npcComponent->getNpcId());
-                    enterMsg.writeString(
-                            o->getComponent<BeingComponent>()->getName());
+                    msg->writeInt16(npcComponent->getNpcId());
+                    msg->writeString(beingComponent->getName());
                 } break;
 
                 default:
                     assert(false); // TODO
                     break;
             }
-            gameHandler->sendTo(p, enterMsg);
+        } break;
+
+        case ACTORMSG_LOOKS:
+        {
+            msg = new MessageOut(GPMSG_BEING_LOOKS_CHANGE);
+            msg->writeInt16(oid);
+            serializeLooks(o, *msg);
+        } break;
+
+        case ACTORMSG_ACTION:
+        {
+            msg = new MessageOut(GPMSG_BEING_ACTION_CHANGE);
+            msg->writeInt16(oid);
+            msg->writeInt8(beingComponent->getAction());
+        } break;
+
+        case ACTORMSG_DIRECTION:
+        {
+            msg = new MessageOut(GPMSG_BEING_DIR_CHANGE);
+            msg->writeInt16(oid);
+            msg->writeInt8(beingComponent->getDirection());
+        } break;
+
+        default:
+            assert(false);
+            break;
+    }
+
+    actorComponent->setCachedMessage(type, msg);
+    return *msg;
+}
+
+/**
+ * Informs a player about what happened to a being around its character.
+ * Movements and damages are appended to the given messages, which are sent
+ * by the caller once all the beings have been handled. Movements go to the
+ * snapshots instead when the client has some.
+ */
+static void informPlayerAboutBeing(Entity *p, Entity *o, int visualRange,
+                                   MessageOut &moveMsg,
+                                   MovementSnapshots *snapshots,
+                                   MessageOut &damageMsg)
+{
+    const Point &pold = p->getComponent<BeingComponent>()->getOldPosition();
+    const Point &ppos = p->getComponent<ActorComponent>()->getPosition();
+    int pflags = p->getComponent<ActorComponent>()->getUpdateFlags();
+
+    const Point &oold = o->getComponent<BeingComponent>()->getOldPosition();
+    const Point &opos = o->getComponent<ActorComponent>()->getPosition();
+    int oid = o->getComponent<ActorComponent>()->getPublicID();
+    int oflags = o->getComponent<ActorComponent>()->getUpdateFlags();
+    int flags = 0;
+
+    // Check if the character p and the moving object o are around.
+    bool wereInRange = pold.inRangeOf(oold, visualRange) &&
+                       !((pflags | oflags) & UPDATEFLAG_NEW_ON_MAP);
+    bool willBeInRange = ppos.inRangeOf(opos, visualRange);
+
+    if (!wereInRange && !willBeInRange)
+    {
+        // Nothing to report: o and p are far away from each other.
+        return;
+    }
+
+    // Beings entering the sight of p are always fully described
+    const int interval = wereInRange && !movementTiers.empty() ?
+            getMovementUpdateInterval(ppos, opos) : 1;
+
+
+    if (wereInRange && willBeInRange)
+    {
+        // Send action change messages.
+        if ((oflags & UPDATEFLAG_ACTIONCHANGE))
+            gameHandler->sendTo(p, getBeingMessage(o, ACTORMSG_ACTION));
+
+        // Send looks change messages.
+        if (oflags & UPDATEFLAG_LOOKSCHANGE)
+            gameHandler->sendTo(p, getBeingMessage(o, ACTORMSG_LOOKS));
+
+        // Send emote messages.
+        if (oflags & UPDATEFLAG_EMOTE)
+        {
+            int emoteId = o->getComponent<BeingComponent>()->getLastEmote();
+            if (emoteId > -1)
+            {
+                MessageOut emoteMsg(GPMSG_BEING_EMOTE);
+                emoteMsg.writeInt16(oid);
+                emoteMsg.writeInt16(emoteId);
+                gameHandler->sendTo(p, emoteMsg);
+            }
         }
 
-        if (opos != oold)
+        // Send direction change messages.
+        if (oflags & UPDATEFLAG_DIRCHANGE && o != p)
+            gameHandler->sendTo(p, getBeingMessage(o, ACTORMSG_DIRECTION));
+
+        // Send ability uses
+        if (oflags & UPDATEFLAG_ABILITY_ON_POINT)
         {
-            // Add position check coords every 5 seconds.
-            if (currentTick % 50 == 0)
-                flags |= MOVING_POSITION;
+            MessageOut abilityMsg(GPMSG_BEING_ABILITY_POINT);
+            abilityMsg.writeInt16(oid);
+            auto *abilityComponent = o->getComponent<AbilityComponent>();
+            const Point &point = abilityComponent->getLastTargetPoint();
+            abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
+            abilityMsg.writeInt16(point.x);
+            abilityMsg.writeInt16(point.y);
+            gameHandler->sendTo(p, abilityMsg);
+        }
 
-            flags |= MOVING_DESTINATION;
+        if (oflags & UPDATEFLAG_ABILITY_ON_BEING)
+        {
+            MessageOut abilityMsg(GPMSG_BEING_ABILITY_BEING);
+            abilityMsg.writeInt16(oid);
+            auto *abilityComponent = o->getComponent<AbilityComponent>();
+            abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
+            abilityMsg.writeInt16(abilityComponent->getLastTargetBeingId());
+            gameHandler->sendTo(p, abilityMsg);
         }
 
-        // Send move messages.
-        moveMsg.writeInt16(oid);
-        moveMsg.writeInt8(flags);
-        if (flags & MOVING_POSITION)
+        if (oflags & UPDATEFLAG_ABILITY_ON_DIRECTION)
         {
-            moveMsg.writeInt16(oold.x);
-            moveMsg.writeInt16(oold.y);
+            MessageOut abilityMsg(GPMSG_BEING_ABILITY_DIRECTION);
+            abilityMsg.writeInt16(oid);
+            auto *abilityComponent = o->getComponent<AbilityComponent>();
+            abilityMsg.writeInt8(abilityComponent->getLastUsedAbilityId());
+            abilityMsg.writeInt8(abilityComponent->getLastTargetDirection());
+            gameHandler->sendTo(p, abilityMsg);
         }
 
-        if (flags & MOVING_DESTINATION)
+        // Send damage messages.
+        if (o->canFight())
         {
-            moveMsg.writeInt16(opos.x);
-            moveMsg.writeInt16(opos.y);
-            // We multiply the sent speed (in tiles per second) by ten
-            // to get it within a byte with decimal precision.
-            // For instance, a value of 4.5 will be sent as 45.
-            auto *tpsSpeedAttribute = attributeManager->getAttributeInfo(ATTR_MOVE_SPEED_TPS);
-            moveMsg.writeInt8((unsigned short)
-                (o->getComponent<BeingComponent>()
-                        ->getModifiedAttribute(tpsSpeedAttribute) * 10));
+            auto *beingComponent = o->getComponent<BeingComponent>();
+            const Hits &hits = beingComponent->getHitsTaken();
+            for (Hits::const_iterator j = hits.begin(),
+                 j_end = hits.end(); j != j_end; ++j)
+            {
+                damageMsg.writeInt16(oid);
+                damageMsg.writeInt16(*j);
+            }
+        }
+
+        if (oold == opos)
+        {
+            // o does not move, nothing more to report. Unless it stopped
+            // while p was only told about its final destination.
+            if (interval == 1 || !(oflags & UPDATEFLAG_NEW_DESTINATION))
+                return;
         }
     }
 
-    // Do not send a packet if nothing happened in p's range.
-    if (moveMsg.getLength() > 2)
-        gameHandler->sendTo(p, moveMsg);
+    if (!willBeInRange)
+    {
+        // o is no longer visible from p. Send leave message.
+        MessageOut leaveMsg(GPMSG_BEING_LEAVE);
+        leaveMsg.writeInt16(oid);
+        gameHandler->sendTo(p, leaveMsg);
+        if (snapshots)
+            snapshots->remove(oid);
+        return;
+    }
 
-    if (damageMsg.getLength() > 2)
-        gameHandler->sendTo(p, damageMsg);
+    if (!wereInRange)
+    {
+        // o is now visible by p. Send enter message.
+        gameHandler->sendTo(p, getBeingMessage(o, ACTORMSG_ENTER));
+    }
 
-    // Inform client about status change.
-    p->getComponent<CharacterComponent>()->sendStatus(*p);
+    Point odst = opos;
+    if (interval > 1)
+    {
+        // Only send the final destination of o, and only on its turn or
+        // when it has reached it.
+        odst = o->getComponent<BeingComponent>()->getDestination();
+        if (odst != opos && (currentTick + oid) % interval != 0)
+            return;
+
+        flags |= MOVING_DESTINATION;
+    }
+    else if (opos != oold)
+    {
+        // Add position check coords every 5 seconds.
+        if (currentTick % 50 == 0)
+            flags |= MOVING_POSITION;
+
+        flags |= MOVING_DESTINATION;
+    }
+
+    int speed = 0;
+    if (flags & MOVING_DESTINATION)
+    {
+        // We multiply the sent speed (in tiles per second) by ten
+        // to get it within a byte with decimal precision.
+        // For instance, a value of 4.5 will be sent as 45.
+        auto *tpsSpeedAttribute = attributeManager->getAttributeInfo(ATTR_MOVE_SPEED_TPS);
+        speed = (unsigned short)
+            (o->getComponent<BeingComponent>()
+                    ->getModifiedAttribute(tpsSpeedAttribute) * 10);
+    }
+
+    if (snapshots)
+    {
+        snapshots->update(oid, flags, oold, odst, speed);
+        return;
+    }
+
+    // Send move messages.
+    moveMsg.writeInt16(oid);
+    moveMsg.writeInt8(flags);
+    if (flags & MOVING_POSITION)
+    {
+        moveMsg.writeInt16(oold.x);
+        moveMsg.writeInt16(oold.y);
+    }
+
+    if (flags & MOVING_DESTINATION)
+    {
+        moveMsg.writeInt16(odst.x);
+        moveMsg.writeInt16(odst.y);
+        moveMsg.writeInt8(speed);
+    }
+}
+
+/**
+ * Informs a player about an item or an effect around its character.
+ * Items are appended to the given message, which is sent by the caller.
+ */
+static void informPlayerAboutFixedActor(Entity *p, Entity *o, int visualRange,
+                                        MessageOut &itemMsg)
+{
+    assert(o->getType() == OBJECT_ITEM ||
+           o->getType() == OBJECT_EFFECT);
+
+    const Point &pold = p->getComponent<BeingComponent>()->getOldPosition();
+    const Point &ppos = p->getComponent<ActorComponent>()->getPosition();
+    int pflags = p->getComponent<ActorComponent>()->getUpdateFlags();
+
+    Point opos = o->getComponent<ActorComponent>()->getPosition();
+    int oflags = o->getComponent<ActorComponent>()->getUpdateFlags();
+    bool willBeInRange = ppos.inRangeOf(opos, visualRange);
+    bool wereInRange = pold.inRangeOf(opos, visualRange) &&
+                       !((pflags | oflags) & UPDATEFLAG_NEW_ON_MAP);
 
-    // Inform client about health change of party members
+    if (!(willBeInRange ^ wereInRange))
+        return;
+
+    switch (o->getType())
+    {
+        case OBJECT_ITEM:
+        {
+            ItemComponent *item = o->getComponent<ItemComponent>();
+            ItemClass *itemClass = item->getItemClass();
+
+            if (oflags & UPDATEFLAG_NEW_ON_MAP)
+            {
+                /* Send a specific message to the client when an item appears
+                   out of nowhere, so that a sound/animation can be performed. */
+                MessageOut appearMsg(GPMSG_ITEM_APPEAR);
+                appearMsg.writeInt16(itemClass->getDatabaseID());
+                appearMsg.writeInt16(opos.x);
+                appearMsg.writeInt16(opos.y);
+                gameHandler->sendTo(p, appearMsg);
+            }
+            else
+            {
+                itemMsg.writeInt16(willBeInRange ? itemClass->getDatabaseID() : 0);
+                itemMsg.writeInt16(opos.x);
+                itemMsg.writeInt16(opos.y);
+            }
+        }
+        break;
+        case OBJECT_EFFECT:
+        {
+            EffectComponent *e = o->getComponent<EffectComponent>();
+            // Don't show old effects
+            if (!(oflags & UPDATEFLAG_NEW_ON_MAP))
+                break;
+
+            if (Entity *b = e->getBeing())
+            {
+                auto *actorComponent = b->getComponent<ActorComponent>();
+                MessageOut effectMsg(GPMSG_CREATE_EFFECT_BEING);
+                effectMsg.writeInt16(e->getEffectId());
+                effectMsg.writeInt16(actorComponent->getPublicID());
+                gameHandler->sendTo(p, effectMsg);
+            } else {
+                MessageOut effectMsg(GPMSG_CREATE_EFFECT_POS);
+                effectMsg.writeInt16(e->getEffectId());
+                effectMsg.writeInt16(opos.x);
+                effectMsg.writeInt16(opos.y);
+                gameHandler->sendTo(p, effectMsg);
+            }
+        }
+        break;
+        default: break;
+    } // Switch
+}
+
+/**
+ * Informs the party members of the characters whose health changed during the
+ * current tick. Only the members that are on the same map are informed.
+ */
+static void informPartyMembers(MapComposite *map)
+{
     for (CharacterIterator i(map->getWholeMapIterator()); i; ++i)
     {
         Entity *c = *i;
 
-        // Make sure its not the same character
-        if (c == p)
+        int cflags = c->getComponent<ActorComponent>()->getUpdateFlags();
+        if (!(cflags & UPDATEFLAG_HEALTHCHANGE))
+            continue;
+
+        // Party id 0 means the character is not in a party
+        int party = c->getComponent<CharacterComponent>()->getParty();
+        if (party == 0)
+            continue;
+
+        const std::vector< Entity * > *members = map->getPartyMembers(party);
+        if (!members || members->size() < 2)
             continue;
 
-        // make sure they are in the same party
-        if (c->getComponent<CharacterComponent>()->getParty() ==
-                p->getComponent<CharacterComponent>()->getParty())
+        auto *beingComponent = c->getComponent<BeingComponent>();
+
+        MessageOut healthMsg(GPMSG_BEING_HEALTH_CHANGE);
+        healthMsg.writeInt16(c->getComponent<ActorComponent>()->getPublicID());
+        auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_HP);
+        healthMsg.writeInt16(beingComponent->getModifiedAttribute(hpAttribute));
+        auto *maxHpAttribute = attributeManager->getAttributeInfo(ATTR_MAX_HP);
+        healthMsg.writeInt16(
+                beingComponent->getModifiedAttribute(maxHpAttribute));
+
+        for (std::vector< Entity * >::const_iterator m = members->begin(),
+             m_end = members->end(); m != m_end; ++m)
         {
-            int cflags = c->getComponent<ActorComponent>()->getUpdateFlags();
-            if (cflags & UPDATEFLAG_HEALTHCHANGE)
-            {
-                auto *beingComponent = c->getComponent<BeingComponent>();
-
-                MessageOut healthMsg(GPMSG_BEING_HEALTH_CHANGE);
-                healthMsg.writeInt16(
-                        c->getComponent<ActorComponent>()->getPublicID());
-                auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_HP);
-                healthMsg.writeInt16(
-                        beingComponent->getModifiedAttribute(hpAttribute));
-                auto *maxHpAttribute = attributeManager->getAttributeInfo(ATTR_MAX_HP);
-                healthMsg.writeInt16(
-                        beingComponent->getModifiedAttribute(maxHpAttribute));
-                gameHandler->sendTo(p, healthMsg);
-            }
+            // Make sure its not the same character
+            if (*m != c)
+                gameHandler->sendTo(*m, healthMsg);
         }
     }
+}
 
-    // Inform client about items on the ground around its character
+/**
+ * Informs a player of what happened around the character.
+ *
+ * When \a onlyChanges is set and the character neither moved nor just
+ * arrived on the map, only the actors collected by
+ * MapComposite::collectChangedActors are looked at. The visibility of all the
+ * other actors is the same as during the previous tick, so there is nothing
+ * to report about them.
+ */
+static void informPlayer(MapComposite *map, Entity *p, int visualRange,
+                         bool onlyChanges)
+{
+    MessageOut moveMsg(GPMSG_BEINGS_MOVE);
+    MessageOut damageMsg(GPMSG_BEINGS_DAMAGE);
     MessageOut itemMsg(GPMSG_ITEMS);
-    for (FixedActorIterator it(map->getAroundBeingIterator(p, visualRange));
-         it; ++it)
-    {
-        Entity *o = *it;
+    const Point &pold = p->getComponent<BeingComponent>()->getOldPosition();
+    const Point &ppos = p->getComponent<ActorComponent>()->getPosition();
+    int pflags = p->getComponent<ActorComponent>()->getUpdateFlags();
 
-        assert(o->getType() == OBJECT_ITEM ||
-               o->getType() == OBJECT_EFFECT);
+    GameClient *client = p->getComponent<CharacterComponent>()->getClient();
+    MovementSnapshots *snapshots =
+            client ? client->movementSnapshots.get() : nullptr;
 
-        Point opos = o->getComponent<ActorComponent>()->getPosition();
-        int oflags = o->getComponent<ActorComponent>()->getUpdateFlags();
-        bool willBeInRange = ppos.inRangeOf(opos, visualRange);
-        bool wereInRange = pold.inRangeOf(opos, visualRange) &&
-                           !((pflags | oflags) & UPDATEFLAG_NEW_ON_MAP);
+    // The beings of the previous map are of no use as bases
+    if (snapshots && (pflags & UPDATEFLAG_NEW_ON_MAP))
+        snapshots->clear();
 
-        if (willBeInRange ^ wereInRange)
+    if (onlyChanges && pold == ppos && !(pflags & UPDATEFLAG_NEW_ON_MAP))
+    {
+        for (ChangedActorIterator it(map->getAroundBeingIterator(p, visualRange));
+             it; ++it)
         {
-            switch (o->getType())
-            {
-                case OBJECT_ITEM:
-                {
-                    ItemComponent *item = o->getComponent<ItemComponent>();
-                    ItemClass *itemClass = item->getItemClass();
-
-                    if (oflags & UPDATEFLAG_NEW_ON_MAP)
-                    {
-                        /* Send a specific message to the client when an item appears
-                           out of nowhere, so that a sound/animation can be performed. */
-                        MessageOut appearMsg(GPMSG_ITEM_APPEAR);
-                        appearMsg.writeInt16(itemClass->getDatabaseID());
-                        appearMsg.writeInt16(opos.x);
-                        appearMsg.writeInt16(opos.y);
-                        gameHandler->sendTo(p, appearMsg);
-                    }
-                    else
-                    {
-                        itemMsg.writeInt16(willBeInRange ? itemClass->getDatabaseID() : 0);
-                        itemMsg.writeInt16(opos.x);
-                        itemMsg.writeInt16(opos.y);
-                    }
-                }
-                break;
-                case OBJECT_EFFECT:
-                {
-                    EffectComponent *e = o->getComponent<EffectComponent>();
-                    // Don't show old effects
-                    if (!(oflags & UPDATEFLAG_NEW_ON_MAP))
-                        break;
-
-                    if (Entity *b = e->getBeing())
-                    {
-                        auto *actorComponent =
-                                b->getComponent<ActorComponent>();
-                        MessageOut effectMsg(GPMSG_CREATE_EFFECT_BEING);
-                        effectMsg.writeInt16(e->getEffectId());
-                        effectMsg.writeInt16(actorComponent->getPublicID());
-                        gameHandler->sendTo(p, effectMsg);
-                    } else {
-                        MessageOut effectMsg(GPMSG_CREATE_EFFECT_POS);
-                        effectMsg.writeInt16(e->getEffectId());
-                        effectMsg.writeInt16(opos.x);
-                        effectMsg.writeInt16(opos.y);
-                        gameHandler->sendTo(p, effectMsg);
-                    }
-                }
-                break;
-                default: break;
-            } // Switch
+            Entity *o = *it;
+            if (o->canMove())
+                informPlayerAboutBeing(p, o, visualRange, moveMsg, snapshots,
+                                       damageMsg);
+            else
+                informPlayerAboutFixedActor(p, o, visualRange, itemMsg);
         }
     }
+    else
+    {
+        // Inform client about activities of other beings near its character
+        for (BeingIterator it(map->getAroundBeingIterator(p, visualRange));
+             it; ++it)
+        {
+            informPlayerAboutBeing(p, *it, visualRange, moveMsg, snapshots,
+                                   damageMsg);
+        }
+
+        // Inform client about items on the ground around its character
+        for (FixedActorIterator it(map->getAroundBeingIterator(p, visualRange));
+             it; ++it)
+        {
+            informPlayerAboutFixedActor(p, *it, visualRange, itemMsg);
+        }
+    }
+
+    if (snapshots)
+    {
+        // Keyframes go along with the position checks. Lost updates are
+        // made up for by the next ones, so they are sent unreliably.
+        MessageOut deltaMsg(GPMSG_BEINGS_MOVE_DELTA);
+        if (snapshots->write(deltaMsg, currentTick % 50 == 0))
+            gameHandler->sendTo(p, deltaMsg, false);
+    }
+    else if (moveMsg.getLength() > 2)
+    {
+        // Do not send a packet if nothing happened in p's range.
+        gameHandler->sendTo(p, moveMsg);
+    }
+
+    if (damageMsg.getLength() > 2)
+        gameHandler->sendTo(p, damageMsg);
+
+    // Inform client about status change.
+    p->getComponent<CharacterComponent>()->sendStatus(*p);
 
     // Do not send a packet if nothing happened in p's range.
     if (itemMsg.getLength() > 2)
         gameHandler->sendTo(p, itemMsg);
 }
 
+/**
+ * Moves the beings of a map, informs the players on it and clears the changes
+ * of the current tick.
+ */
+static void updateMap(MapComposite *map, int visualRange, bool deltaVisibility,
+                      MapTickTimes &times)
+{
+    TickProfiler::Stopwatch stopwatch;
+
+    map->updateMovement();
+    times.update += stopwatch.lap();
+
+    if (deltaVisibility)
+        map->collectChangedActors();
+
+    for (CharacterIterator p(map->getWholeMapIterator()); p; ++p)
+    {
+        informPlayer(map, *p, visualRange, deltaVisibility);
+    }
+
+    // Inform clients about health change of party members
+    informPartyMembers(map);
+
+    for (ActorIterator it(map->getWholeMapIterator()); it; ++it)
+    {
+        Entity *a = *it;
+        a->getComponent<ActorComponent>()->clearUpdateFlags();
+        if (a->canFight())
+        {
+            a->getComponent<BeingComponent>()->clearHitsTaken();
+        }
+    }
+    times.inform += stopwatch.lap();
+}
+
+/**
+ * Runs updateMap on a worker thread. The messages to the clients are held
+ * back, to be sent from the main thread.
+ */
+struct MapUpdateJob
+{
+    MapUpdateJob(MapComposite *map, DeferredMessages *messages,
+                 MapTickTimes *times, int visualRange, bool deltaVisibility):
+        map(map),
+        messages(messages),
+        times(times),
+        visualRange(visualRange),
+        deltaVisibility(deltaVisibility)
+    {}
+
+    void operator()() const
+    {
+        GameHandler::deferMessages(messages);
+        updateMap(map, visualRange, deltaVisibility, *times);
+        GameHandler::deferMessages(nullptr);
+    }
+
+    MapComposite *map;
+    DeferredMessages *messages;
+    MapTickTimes *times;
+    int visualRange;
+    bool deltaVisibility;
+};
+
 #ifndef NDEBUG
 static bool dbgLockObjects;
 #endif
 
+void GameState::initialize()
+{
+    const int workerThreads = workerThreadsOption;
+    if (workerThreads > 0 && !mapWorkers)
+    {
+        LOG_INFO("Updating maps with " << workerThreads << " threads.");
+        mapWorkers = new utils::WorkerPool(workerThreads);
+    }
+}
+
 void GameState::update(int tick)
 {
     currentTick = tick;
@@ -478,40 +811,104 @@ void GameState::update(int tick)
     dbgLockObjects = true;
 #endif
 
+    TickProfiler::Stopwatch stopwatch;
+
+    TimerWheel::advance(tick);
+
     ScriptManager::currentState()->update();
+    TickProfiler::addSample(TICK_PHASE_SCRIPT, stopwatch.lap());
+
+    const int visualRange = visualRangeOption;
+    const bool deltaVisibility = deltaVisibilityOption;
+
+    if (!movementTiersRead)
+    {
+        readMovementTiers();
+        movementTiersOption.signal_changed.connect(
+                sigc::ptr_fun(&readMovementTiers));
+        movementTiersRead = true;
+    }
 
     // Update game state (update AI, etc.)
     const MapManager::Maps &maps = MapManager::getMaps();
-    for (MapManager::Maps::const_iterator m = maps.begin(),
-         m_end = maps.end(); m != m_end; ++m)
+
+    activeMaps.clear();
+    mapTimes.clear();
+
+    if (!mapWorkers)
     {
-        MapComposite *map = m->second;
-        if (!map->isActive())
-            continue;
+        for (MapManager::Maps::const_iterator m = maps.begin(),
+             m_end = maps.end(); m != m_end; ++m)
+        {
+            MapComposite *map = m->second;
+            if (!map->isActive())
+                continue;
 
-        map->update();
+            activeMaps.push_back(map);
+            mapTimes.push_back(MapTickTimes());
+            MapTickTimes &times = mapTimes.back();
 
-        for (CharacterIterator p(map->getWholeMapIterator()); p; ++p)
+            stopwatch.lap();
+            map->update();
+            times.update += stopwatch.lap();
+            updateMap(map, visualRange, deltaVisibility, times);
+        }
+    }
+    else
+    {
+        // Entities are updated on the main thread, since they run scripts.
+        for (MapManager::Maps::const_iterator m = maps.begin(),
+             m_end = maps.end(); m != m_end; ++m)
         {
-            informPlayer(map, *p);
+            MapComposite *map = m->second;
+            if (!map->isActive())
+                continue;
+
+            activeMaps.push_back(map);
+            mapTimes.push_back(MapTickTimes());
+
+            stopwatch.lap();
+            map->update();
+            mapTimes.back().update += stopwatch.lap();
         }
 
-        for (ActorIterator it(map->getWholeMapIterator()); it; ++it)
+        // The rest of the update of each map only touches the map itself.
+        if (mapMessages.size() < activeMaps.size())
+            mapMessages.resize(activeMaps.size());
+
+        for (unsigned i = 0; i < activeMaps.size(); ++i)
         {
-            Entity *a = *it;
-            a->getComponent<ActorComponent>()->clearUpdateFlags();
-            if (a->canFight())
-            {
-                a->getComponent<BeingComponent>()->clearHitsTaken();
-            }
+            mapWorkers->enqueue(MapUpdateJob(activeMaps[i], &mapMessages[i],
+                                             &mapTimes[i], visualRange,
+                                             deltaVisibility));
         }
+        mapWorkers->wait();
+
+        // Send the messages in a deterministic order.
+        for (unsigned i = 0; i < activeMaps.size(); ++i)
+            mapMessages[i].send();
     }
 
+    // With worker threads, these are the time spent by all the threads
+    // together rather than the duration of the phases.
+    unsigned updateTime = 0, informTime = 0;
+    for (unsigned i = 0; i < activeMaps.size(); ++i)
+    {
+        const MapTickTimes &times = mapTimes[i];
+        TickProfiler::addMapSample(activeMaps[i]->getID(),
+                                   times.update + times.inform);
+        updateTime += times.update;
+        informTime += times.inform;
+    }
+    TickProfiler::addSample(TICK_PHASE_MAP_UPDATE, updateTime);
+    TickProfiler::addSample(TICK_PHASE_INFORM, informTime);
+
 #   ifndef NDEBUG
     dbgLockObjects = false;
 #   endif
 
     // Take care of events that were delayed because of their side effects.
+    stopwatch.lap();
     for (DelayedEvents::iterator it = delayedEvents.begin(),
          it_end = delayedEvents.end(); it != it_end; ++it)
     {
@@ -540,6 +937,11 @@ void GameState::update(int tick)
         }
     }
     delayedEvents.clear();
+    TickProfiler::addSample(TICK_PHASE_DELAYED_EVENTS, stopwatch.lap());
+
+    // Search for the requested paths while the next ticks run
+    AsyncPathFinder::dispatch();
+    TickProfiler::addSample(TICK_PHASE_PATHS, stopwatch.lap());
 }
 
 bool GameState::insert(Entity *ptr)
@@ -653,7 +1055,7 @@ void GameState::remove(Entity *ptr)
 {
     assert(!dbgLockObjects);
     MapComposite *map = ptr->getMap();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    int visualRange = visualRangeOption;
 
     ptr->signal_removed.emit(ptr);
 
@@ -706,8 +1108,9 @@ void GameState::remove(Entity *ptr)
                     characterComponent->getDatabaseID(), false);
         }
 
+        const int id = ptr->getComponent<ActorComponent>()->getPublicID();
         MessageOut msg(GPMSG_BEING_LEAVE);
-        msg.writeInt16(ptr->getComponent<ActorComponent>()->getPublicID());
+        msg.writeInt16(id);
         Point objectPos = ptr->getComponent<ActorComponent>()->getPosition();
 
         for (CharacterIterator p(map->getAroundActorIterator(ptr, visualRange));
@@ -718,6 +1121,12 @@ void GameState::remove(Entity *ptr)
                 visualRange))
             {
                 gameHandler->sendTo(*p, msg);
+
+                // The public ID may be given to another being
+                GameClient *client =
+                        (*p)->getComponent<CharacterComponent>()->getClient();
+                if (client && client->movementSnapshots)
+                    client->movementSnapshots->remove(id);
             }
         }
     }
@@ -833,7 +1242,7 @@ void GameState::enqueueWarp(Entity *ptr,
 void GameState::sayAround(Entity *entity, const std::string &text)
 {
     Point speakerPosition = entity->getComponent<ActorComponent>()->getPosition();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    int visualRange = visualRangeOption;
 
     for (CharacterIterator i(entity->getMap()->getAroundActorIterator(entity, visualRange)); i; ++i)
     {
@@ -21,6 +21,7 @@
 #ifndef STATE_H
 #define STATE_H
 
+#include "common/configuration.h"
 #include "utils/point.h"
 
 #include <string>
@@ -31,6 +32,18 @@ class MapComposite;
 
 namespace GameState
 {
+    /**
+     * Distance in pixels up to which the characters see the beings around
+     * them.
+     */
+    extern Configuration::IntOption visualRangeOption;
+
+    /**
+     * Starts the threads updating the maps when the game_workerThreads
+     * option is set, which is only read here.
+     */
+    void initialize();
+
     /**
      * Updates game state (contains core server logic).
      */
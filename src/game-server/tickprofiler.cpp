@@ -0,0 +1,202 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/tickprofiler.h"
+
+#include "common/defines.h"
+#include "utils/logger.h"
+
+#include <map>
+
+using namespace ManaServ;
+
+/**
+ * Number of ticks the percentiles are computed over (one minute).
+ */
+static const unsigned WINDOW_SIZE = 600;
+
+/**
+ * Durations below SUB_BUCKETS microseconds get their own bucket. Above that,
+ * every power of two is split into SUB_BUCKETS buckets, which keeps the error
+ * on the percentiles under 12.5%.
+ */
+static const unsigned SUB_BUCKET_BITS = 3;
+static const unsigned SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+static const unsigned NB_BUCKETS =
+        SUB_BUCKETS + (32 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+static unsigned getBucket(unsigned value)
+{
+    if (value < SUB_BUCKETS)
+        return value;
+
+    unsigned exponent = SUB_BUCKET_BITS;
+    while (exponent < 31 && (value >> (exponent + 1)))
+        ++exponent;
+
+    const unsigned shift = exponent - SUB_BUCKET_BITS;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + (value >> shift) - SUB_BUCKETS;
+}
+
+/**
+ * Gets the highest duration falling into a bucket.
+ */
+static unsigned getBucketLimit(unsigned bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+
+    const unsigned shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+    const unsigned sub = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub) << shift) + ((1u << shift) - 1);
+}
+
+/**
+ * Histogram of the durations recorded over the last WINDOW_SIZE samples.
+ * Adding a sample and reading a percentile take constant time.
+ */
+class TickHistogram
+{
+    public:
+        TickHistogram()
+            : mCounts()
+            , mSamples()
+            , mNext(0)
+            , mSize(0)
+        {}
+
+        void add(unsigned value)
+        {
+            if (mSize == WINDOW_SIZE)
+                --mCounts[mSamples[mNext]];
+            else
+                ++mSize;
+
+            const unsigned bucket = getBucket(value);
+            ++mCounts[bucket];
+            mSamples[mNext] = bucket;
+            mNext = (mNext + 1) % WINDOW_SIZE;
+        }
+
+        unsigned getPercentile(int percent) const
+        {
+            if (!mSize)
+                return 0;
+
+            unsigned rank = (mSize * percent + 99) / 100;
+            if (rank == 0)
+                rank = 1;
+
+            unsigned count = 0;
+            for (unsigned bucket = 0; bucket < NB_BUCKETS; ++bucket)
+            {
+                count += mCounts[bucket];
+                if (count >= rank)
+                    return getBucketLimit(bucket);
+            }
+            return getBucketLimit(NB_BUCKETS - 1);
+        }
+
+        unsigned getSize() const
+        { return mSize; }
+
+    private:
+        unsigned short mCounts[NB_BUCKETS]; /**< Samples in each bucket. */
+        unsigned char mSamples[WINDOW_SIZE];/**< Buckets of the samples. */
+        unsigned mNext;                     /**< Oldest sample. */
+        unsigned mSize;                     /**< Number of samples. */
+};
+
+typedef std::map< int, TickHistogram > MapHistograms;
+
+static TickHistogram phaseHistograms[NB_TICK_PHASES];
+static MapHistograms mapHistograms;
+
+void TickProfiler::addSample(TickPhase phase, unsigned microseconds)
+{
+    phaseHistograms[phase].add(microseconds);
+}
+
+void TickProfiler::addMapSample(int mapId, unsigned microseconds)
+{
+    mapHistograms[mapId].add(microseconds);
+}
+
+unsigned TickProfiler::getPercentile(TickPhase phase, int percent)
+{
+    return phaseHistograms[phase].getPercentile(percent);
+}
+
+unsigned TickProfiler::getMapPercentile(int mapId, int percent)
+{
+    MapHistograms::const_iterator it = mapHistograms.find(mapId);
+    if (it == mapHistograms.end())
+        return 0;
+    return it->second.getPercentile(percent);
+}
+
+void TickProfiler::logSummary()
+{
+    for (int phase = 0; phase < NB_TICK_PHASES; ++phase)
+    {
+        const TickHistogram &histogram = phaseHistograms[phase];
+        if (!histogram.getSize())
+            continue;
+
+        LOG_INFO("Tick phase " << getTickPhaseName(phase)
+                 << ": p50 " << histogram.getPercentile(50)
+                 << " us, p95 " << histogram.getPercentile(95)
+                 << " us, p99 " << histogram.getPercentile(99) << " us");
+    }
+
+    int slowestMap = 0;
+    unsigned slowestTime = 0;
+    for (MapHistograms::const_iterator it = mapHistograms.begin(),
+         it_end = mapHistograms.end(); it != it_end; ++it)
+    {
+        const unsigned time = it->second.getPercentile(99);
+        if (time > slowestTime)
+        {
+            slowestMap = it->first;
+            slowestTime = time;
+        }
+    }
+    if (slowestTime)
+    {
+        LOG_INFO("Slowest map: " << slowestMap << " (p99 " << slowestTime
+                 << " us)");
+    }
+
+    const unsigned budget = WORLD_TICK_MS * 1000;
+    const unsigned tickTime = phaseHistograms[TICK_PHASE_TOTAL]
+            .getPercentile(95);
+    if (tickTime > budget)
+    {
+        LOG_WARN("Ticks are running over budget: p95 of " << tickTime
+                 << " us for " << budget << " us per tick.");
+    }
+}
+
+void TickProfiler::reset()
+{
+    for (int phase = 0; phase < NB_TICK_PHASES; ++phase)
+        phaseHistograms[phase] = TickHistogram();
+    mapHistograms.clear();
+}
@@ -0,0 +1,100 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TICKPROFILER_H
+#define TICKPROFILER_H
+
+#include "common/manaserv_protocol.h"
+
+#include <chrono>
+
+/**
+ * Keeps track of the time spent in the phases of the world ticks and in the
+ * update of each map, over a rolling window of the last ticks.
+ *
+ * Only to be used from the main thread.
+ */
+namespace TickProfiler
+{
+    /**
+     * Measures elapsed time, in microseconds.
+     */
+    class Stopwatch
+    {
+        public:
+            Stopwatch()
+                : mStart(std::chrono::steady_clock::now())
+            {}
+
+            /**
+             * Returns the time elapsed since the creation of the stopwatch
+             * or the previous call, and restarts it.
+             */
+            unsigned lap()
+            {
+                std::chrono::steady_clock::time_point now =
+                        std::chrono::steady_clock::now();
+                unsigned elapsed = std::chrono::duration_cast<
+                        std::chrono::microseconds>(now - mStart).count();
+                mStart = now;
+                return elapsed;
+            }
+
+        private:
+            std::chrono::steady_clock::time_point mStart;
+    };
+
+    /**
+     * Records the duration of a phase of the current tick.
+     */
+    void addSample(ManaServ::TickPhase phase, unsigned microseconds);
+
+    /**
+     * Records the time spent updating a map during the current tick.
+     */
+    void addMapSample(int mapId, unsigned microseconds);
+
+    /**
+     * Gets a percentile of the duration of a phase over the rolling window.
+     *
+     * @return the duration in microseconds, or 0 when nothing was recorded.
+     */
+    unsigned getPercentile(ManaServ::TickPhase phase, int percent);
+
+    /**
+     * Gets a percentile of the update time of a map over the rolling window.
+     *
+     * @return the duration in microseconds, or 0 when nothing was recorded.
+     */
+    unsigned getMapPercentile(int mapId, int percent);
+
+    /**
+     * Logs the percentiles of every phase, and warns when the ticks run
+     * over their budget.
+     */
+    void logSummary();
+
+    /**
+     * Forgets all the recorded samples.
+     */
+    void reset();
+}
+
+#endif // TICKPROFILER_H
@@ -0,0 +1,254 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/timerwheel.h"
+
+#include "game-server/state.h"
+
+/**
+ * The slots of the timer wheel. Each slot is a circular list of timers with
+ * the slot itself as the list head.
+ *
+ * The root level has a slot for each of the next 256 ticks. Each of the
+ * other levels has 64 slots covering 64 times as many ticks as the level
+ * below. Whenever the root level wraps around, the timers of the next slot
+ * in the level above are redistributed over the levels below, and so on.
+ */
+class TimerSlots
+{
+    public:
+        static const int ROOT_BITS = 8;
+        static const int ROOT_SIZE = 1 << ROOT_BITS;
+        static const int LEVEL_BITS = 6;
+        static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+        static const int LEVELS = 3;
+
+        TimerSlots()
+            : mNextTick(0)
+            , mActiveTimers(0)
+        {}
+
+        void insert(Timer *timer);
+        void remove(Timer *timer);
+        void advance(int tick);
+
+    private:
+        static void append(Timer *head, Timer *timer);
+        static void moveAll(Timer *from, Timer *to);
+
+        bool cascade(int level, int index);
+        void fire(Timer *head);
+
+        static int levelIndex(int level, int tick)
+        {
+            return (tick >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+        }
+
+        Timer mRoot[ROOT_SIZE];
+        Timer mLevels[LEVELS][LEVEL_SIZE];
+
+        int mNextTick;      /**< Next tick to fire the timers of. */
+        int mActiveTimers;
+};
+
+/**
+ * The timer slots are never destroyed, since timers owned by other statics
+ * may still stop themselves during static destruction.
+ */
+static TimerSlots &timerSlots()
+{
+    static TimerSlots *slots = new TimerSlots;
+    return *slots;
+}
+
+void TimerSlots::append(Timer *head, Timer *timer)
+{
+    timer->mPrev = head->mPrev;
+    timer->mNext = head;
+    head->mPrev->mNext = timer;
+    head->mPrev = timer;
+}
+
+void TimerSlots::moveAll(Timer *from, Timer *to)
+{
+    if (from->mNext == from)
+        return;
+
+    from->mNext->mPrev = to->mPrev;
+    to->mPrev->mNext = from->mNext;
+    from->mPrev->mNext = to;
+    to->mPrev = from->mPrev;
+    from->mNext = from->mPrev = from;
+}
+
+void TimerSlots::insert(Timer *timer)
+{
+    const int expiry = timer->mExpiry;
+    const int delta = expiry - mNextTick;
+
+    Timer *head;
+    if (delta < 0)
+    {
+        head = &mRoot[mNextTick & (ROOT_SIZE - 1)];
+    }
+    else if (delta < ROOT_SIZE)
+    {
+        head = &mRoot[expiry & (ROOT_SIZE - 1)];
+    }
+    else
+    {
+        int level = 0;
+        while (level < LEVELS - 1 &&
+               delta >= 1 << (ROOT_BITS + (level + 1) * LEVEL_BITS))
+            ++level;
+
+        // Timers beyond the range of the wheel go to the furthest slot, and
+        // are put back on the wheel when that slot gets redistributed.
+        int slotTick = expiry;
+        if (delta >= 1 << (ROOT_BITS + LEVELS * LEVEL_BITS))
+            slotTick = mNextTick + (1 << (ROOT_BITS + LEVELS * LEVEL_BITS)) - 1;
+
+        head = &mLevels[level][levelIndex(level, slotTick)];
+    }
+
+    append(head, timer);
+    ++mActiveTimers;
+}
+
+void TimerSlots::remove(Timer *timer)
+{
+    timer->unlink();
+    --mActiveTimers;
+}
+
+bool TimerSlots::cascade(int level, int index)
+{
+    Timer pending;
+    moveAll(&mLevels[level][index], &pending);
+
+    while (pending.mNext != &pending)
+    {
+        Timer *timer = pending.mNext;
+        timer->unlink();
+        --mActiveTimers;
+        insert(timer);
+    }
+
+    return index == 0;
+}
+
+void TimerSlots::fire(Timer *head)
+{
+    Timer expired;
+    moveAll(head, &expired);
+
+    // Callbacks may start and stop any timer, including the ones still
+    // waiting in this list.
+    while (expired.mNext != &expired)
+    {
+        Timer *timer = expired.mNext;
+        remove(timer);
+
+        Timer::Callback callback = timer->mCallback;
+        callback();
+    }
+}
+
+void TimerSlots::advance(int tick)
+{
+    // Skip ahead when there is nothing to do, for example on the first tick.
+    if (mActiveTimers == 0 && tick >= mNextTick)
+    {
+        mNextTick = tick + 1;
+        return;
+    }
+
+    while (mNextTick <= tick)
+    {
+        const int current = mNextTick;
+        const int index = current & (ROOT_SIZE - 1);
+
+        if (index == 0)
+        {
+            for (int level = 0; level < LEVELS; ++level)
+                if (!cascade(level, levelIndex(level, current)))
+                    break;
+        }
+
+        ++mNextTick;
+        fire(&mRoot[index]);
+    }
+}
+
+
+Timer::Timer()
+    : mPrev(this)
+    , mNext(this)
+    , mExpiry(0)
+{}
+
+Timer::Timer(const Timer &)
+    : mPrev(this)
+    , mNext(this)
+    , mExpiry(0)
+{}
+
+Timer &Timer::operator=(const Timer &)
+{
+    return *this;
+}
+
+Timer::~Timer()
+{
+    stop();
+}
+
+void Timer::unlink()
+{
+    mPrev->mNext = mNext;
+    mNext->mPrev = mPrev;
+    mPrev = mNext = this;
+}
+
+void Timer::start(int ticks, const Callback &callback)
+{
+    stop();
+
+    mExpiry = GameState::getCurrentTick() + (ticks > 0 ? ticks : 1);
+    mCallback = callback;
+    timerSlots().insert(this);
+}
+
+void Timer::stop()
+{
+    if (isActive())
+        timerSlots().remove(this);
+}
+
+int Timer::remaining() const
+{
+    return isActive() ? mExpiry - GameState::getCurrentTick() : 0;
+}
+
+
+void TimerWheel::advance(int tick)
+{
+    timerSlots().advance(tick);
+}
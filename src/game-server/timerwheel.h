@@ -0,0 +1,98 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <sigc++/functors/slot.h>
+
+/**
+ * A callback to run at a given world tick.
+ *
+ * Unlike a Timeout, which has to be polled, a started timer is kept in the
+ * timer wheel and only looked at when it fires, so that waiting timers cost
+ * nothing per tick. Destroying or stopping a timer cancels it. A copy of a
+ * timer is not started.
+ *
+ * Timers may only be used from the main thread.
+ */
+class Timer
+{
+    public:
+        typedef sigc::slot<void> Callback;
+
+        Timer();
+
+        Timer(const Timer &);
+
+        Timer &operator=(const Timer &);
+
+        ~Timer();
+
+        /**
+         * Starts the timer, so that \a callback is called \a ticks ticks in
+         * the future. Timers started for 0 ticks or less fire at the next
+         * tick. Restarts the timer when it was already started.
+         */
+        void start(int ticks, const Callback &callback);
+
+        /**
+         * Cancels the timer when it was started.
+         */
+        void stop();
+
+        /**
+         * Returns whether the timer was started and did not fire yet.
+         */
+        bool isActive() const
+        { return mNext != this; }
+
+        /**
+         * Returns the number of ticks until the timer fires, or 0 when it is
+         * not active.
+         */
+        int remaining() const;
+
+    private:
+        void unlink();
+
+        Timer *mPrev;       /**< Previous timer in the same slot. */
+        Timer *mNext;       /**< Next timer in the same slot. */
+        int mExpiry;        /**< World tick at which the timer fires. */
+        Callback mCallback;
+
+        friend class TimerSlots;
+};
+
+/**
+ * Keeps the started timers in slots by expiry time, with coarser slots for
+ * the timers that fire later. Advancing to the next tick only looks at the
+ * timers firing in that tick, plus a regular redistribution of the timers
+ * from the coarser slots.
+ */
+namespace TimerWheel
+{
+    /**
+     * Fires the timers expiring up to the given world tick.
+     */
+    void advance(int tick);
+}
+
+#endif // TIMERWHEEL_H
@@ -120,7 +120,8 @@ void ConnectionHandler::process(enet_uint32 timeout)
                 // Make sure that the packet is big enough (> short)
                 if (event.packet->dataLength >= 2) {
                     MessageIn msg((char *)event.packet->data,
-                                  event.packet->dataLength);
+                                  event.packet->dataLength,
+                                  comp->usesCompactEncoding());
                     LOG_DEBUG("Received message " << msg << " from "
                               << *comp);
 
@@ -153,12 +154,16 @@ void ConnectionHandler::process(enet_uint32 timeout)
     }
 }
 
-void ConnectionHandler::sendToEveryone(const MessageOut &msg)
+void ConnectionHandler::sendToEveryone(MessageOut &msg)
 {
+    LOG_DEBUG("Sending message " << msg << " to everyone");
+
+    // Everyone gets the same packet
+    SharedPacket packet(msg);
     for (NetComputers::iterator i = clients.begin(), i_end = clients.end();
          i != i_end; ++i)
     {
-        (*i)->send(msg);
+        (*i)->send(packet);
     }
 }
 
@@ -72,9 +72,10 @@ class ConnectionHandler
         //void receivePacket(NetComputer *computer, Packet *packet);
 
         /**
-         * Send packet to every client, used for announcements.
+         * Send packet to every client, used for announcements. The message
+         * is left empty.
          */
-        void sendToEveryone(const MessageOut &msg);
+        void sendToEveryone(MessageOut &msg);
 
         /**
          * Return the number of connected clients.
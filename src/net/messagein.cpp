@@ -43,14 +43,16 @@
 #define ASSERT_IF(x) if (x)
 #endif
 
-MessageIn::MessageIn(const char *data, unsigned short length):
+MessageIn::MessageIn(const char *data, unsigned short length, bool compact):
     mData(data),
     mLength(length),
     mDebugMode(false),
+    mCompact(false),
     mPos(0)
 {
-    // Read the message ID
+    // Read the message ID, which is never compacted
     mId = readInt16();
+    mCompact = compact;
 
     // Read and clear the debug flag
     mDebugMode = mId & ManaServ::XXMSG_DEBUG_FLAG;
@@ -84,6 +86,9 @@ int MessageIn::readInt16()
     if (!readValueType(ManaServ::Int16))
         return value;
 
+    if (mCompact)
+        return (short) readVarInt();
+
     ASSERT_IF (mPos + 2 <= mLength)
     {
         uint16_t t;
@@ -106,6 +111,9 @@ int MessageIn::readInt32()
     if (!readValueType(ManaServ::Int32))
         return value;
 
+    if (mCompact)
+        return readVarInt();
+
     ASSERT_IF (mPos + 4 <= mLength)
     {
         uint32_t t;
@@ -183,6 +191,32 @@ std::string MessageIn::readString(int length)
     return readString;
 }
 
+int MessageIn::readVarInt()
+{
+    uint32_t bits = 0;
+
+    for (unsigned shift = 0; shift < 35; shift += 7)
+    {
+        if (mPos >= mLength)
+        {
+            LOG_DEBUG("Unable to read integer in " << mId << "!");
+            mPos = mLength + 1;
+            return -1;
+        }
+
+        const unsigned char byte = mData[mPos];
+        ++mPos;
+        bits |= uint32_t(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80))
+            return int32_t(bits >> 1) ^ -int32_t(bits & 1);
+    }
+
+    LOG_DEBUG("Integer too long in " << mId << "!");
+    mPos = mLength + 1;
+    return -1;
+}
+
 bool MessageIn::readValueType(ManaServ::ValueType type)
 {
     if (!mDebugMode) // Verification not possible
@@ -224,7 +258,7 @@ operator <<(std::ostream &os, const MessageIn &msg)
     {
         os << " { ";
 
-        MessageIn m(msg.mData, msg.mLength);
+        MessageIn m(msg.mData, msg.mLength, msg.mCompact);
 
         while (m.getUnreadLength() > 0)
         {
@@ -34,10 +34,12 @@ class MessageIn
         /**
          * Constructor.
          *
-         * @param data   the message data
-         * @param length the length of the data
+         * @param data    the message data
+         * @param length  the length of the data
+         * @param compact whether the message is in the compact encoding
          */
-        MessageIn(const char *data, unsigned short length);
+        MessageIn(const char *data, unsigned short length,
+                  bool compact = false);
 
         /**
          * Returns the message ID.
@@ -74,10 +76,13 @@ class MessageIn
     private:
         bool readValueType(ManaServ::ValueType type);
 
+        int readVarInt();           /**< Reads a zigzag varint. */
+
         const char *mData;            /**< Packet data */
         unsigned short mLength;       /**< Length of data in bytes */
         unsigned short mId;           /**< The message ID. */
         bool mDebugMode;              /**< Includes debugging information. */
+        bool mCompact;                /**< Integers are varints. */
 
         /**
          * Actual position in the packet. From 0 to packet->length. A value
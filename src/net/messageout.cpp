@@ -21,6 +21,7 @@
 #include "net/messageout.h"
 #include "net/messagein.h"
 
+#include <cassert>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
@@ -30,49 +31,187 @@
 #endif
 #include <stdint.h>
 #include <string>
+#include <vector>
 #include <enet/enet.h>
 
-/** Initial amount of bytes allocated for the messageout data buffer. */
-const unsigned INITIAL_DATA_CAPACITY = 16;
-
 /** Factor by which the messageout data buffer is increased when too small. */
 const unsigned CAPACITY_GROW_FACTOR = 2;
 
+/** Sizes of the buffers kept for reuse, as powers of two. */
+const unsigned MIN_POOLED_SIZE_SHIFT = 7;
+const unsigned MAX_POOLED_SIZE_SHIFT = 16;
+
+/** Number of buffers of each size a thread keeps for reuse. */
+const unsigned MAX_POOLED_BUFFERS = 16;
+
 static bool debugModeEnabled = false;
+static bool compactEncodingEnabled = false;
+
+/**
+ * Data buffers of messages that were larger than their inline data, kept
+ * for the next messages to avoid allocating them again. Buffers may be
+ * allocated by one thread and released by another.
+ */
+class BufferPool
+{
+    public:
+        char *acquire(unsigned size)
+        {
+            const int index = sizeIndex(size);
+            if (index >= 0 && !mBuffers[index].empty())
+            {
+                char *buffer = mBuffers[index].back();
+                mBuffers[index].pop_back();
+                return buffer;
+            }
+            return (char*) malloc(size);
+        }
+
+        void release(char *buffer, unsigned size)
+        {
+            const int index = sizeIndex(size);
+            if (index >= 0 && mBuffers[index].size() < MAX_POOLED_BUFFERS)
+                mBuffers[index].push_back(buffer);
+            else
+                free(buffer);
+        }
+
+    private:
+        static const unsigned NB_SIZES =
+                MAX_POOLED_SIZE_SHIFT - MIN_POOLED_SIZE_SHIFT + 1;
+
+        /**
+         * Returns the index of the buffers of the given size, or -1 when
+         * buffers of that size are not kept.
+         */
+        static int sizeIndex(unsigned size)
+        {
+            for (unsigned i = 0; i < NB_SIZES; ++i)
+                if (size == 1u << (MIN_POOLED_SIZE_SHIFT + i))
+                    return i;
+            return -1;
+        }
+
+        std::vector<char*> mBuffers[NB_SIZES];
+};
+
+/**
+ * Returns the buffer pool of the current thread. It is never destroyed, as
+ * messages may still be destroyed after it would be, like static messages
+ * at exit or messages of a thread that is stopping.
+ */
+static BufferPool &getBufferPool()
+{
+    static thread_local BufferPool *pool = new BufferPool;
+    return *pool;
+}
+
+/**
+ * Appends an integer to the given data as a zigzag varint.
+ */
+static void appendVarInt(std::vector<char> &data, int32_t value)
+{
+    uint32_t bits = (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+    while (bits >= 0x80)
+    {
+        data.push_back(char(bits | 0x80));
+        bits >>= 7;
+    }
+    data.push_back(char(bits));
+}
 
 MessageOut::MessageOut(int id):
+    mData(mInlineData),
     mPos(0),
-    mDebugMode(false)
+    mDataSize(INLINE_DATA_CAPACITY),
+    mDebugMode(false),
+    mTrackFields(false),
+    mFieldCount(0),
+    mFields(mInlineFields),
+    mFieldCapacity(INLINE_FIELDS_CAPACITY)
 {
-    mData = (char*) malloc(INITIAL_DATA_CAPACITY);
-    mDataSize = INITIAL_DATA_CAPACITY;
+    reset(id);
+}
+
+MessageOut::~MessageOut()
+{
+    releaseData();
+    releaseFields();
+}
+
+void MessageOut::reset(int id)
+{
+    mPos = 0;
+    mDebugMode = false;
+    mTrackFields = false;
+    mFieldCount = 0;
 
     if (debugModeEnabled)
         id |= ManaServ::XXMSG_DEBUG_FLAG;
 
+    // The ID is never compacted
     writeInt16(id);
     mDebugMode = debugModeEnabled;
+    mTrackFields = compactEncodingEnabled;
 }
 
-MessageOut::~MessageOut()
+void MessageOut::releaseData()
 {
-    free(mData);
+    if (mData != mInlineData)
+        getBufferPool().release(mData, mDataSize);
+}
+
+void MessageOut::releaseFields()
+{
+    if (mFields != mInlineFields)
+    {
+        getBufferPool().release(reinterpret_cast<char*>(mFields),
+                                mFieldCapacity * sizeof(uint32_t));
+    }
 }
 
 void MessageOut::expand(size_t bytes)
 {
     if (bytes > mDataSize)
     {
-        do
-        {
-            mDataSize *= CAPACITY_GROW_FACTOR;
-        }
-        while (bytes > mDataSize);
+        const unsigned dataSize = grownDataSize(bytes);
+        char *data = getBufferPool().acquire(dataSize);
+        memcpy(data, mData, mPos);
+        releaseData();
 
-        mData = (char*) realloc(mData, mDataSize);
+        mData = data;
+        mDataSize = dataSize;
     }
 }
 
+unsigned MessageOut::grownDataSize(size_t bytes)
+{
+    unsigned dataSize = INLINE_DATA_CAPACITY;
+    while (bytes > dataSize)
+        dataSize *= CAPACITY_GROW_FACTOR;
+    return dataSize;
+}
+
+char *MessageOut::takeData()
+{
+    // The size of the buffer has to follow from the length of the data, as
+    // it is the only thing known about it when given back
+    if (mData == mInlineData || mDataSize != grownDataSize(mPos))
+        return nullptr;
+
+    char *data = mData;
+    mData = mInlineData;
+    mDataSize = INLINE_DATA_CAPACITY;
+    mPos = 0;
+    mFieldCount = 0;
+    return data;
+}
+
+void MessageOut::releaseTakenData(char *data, unsigned length)
+{
+    getBufferPool().release(data, grownDataSize(length));
+}
+
 void MessageOut::writeInt8(int value)
 {
     if (mDebugMode)
@@ -88,6 +227,9 @@ void MessageOut::writeInt16(int value)
     if (mDebugMode)
         writeValueType(ManaServ::Int16);
 
+    if (mTrackFields)
+        addField(ManaServ::Int16);
+
     expand(mPos + 2);
     uint16_t t = ENET_HOST_TO_NET_16(value);
     memcpy(mData + mPos, &t, 2);
@@ -99,6 +241,9 @@ void MessageOut::writeInt32(int value)
     if (mDebugMode)
         writeValueType(ManaServ::Int32);
 
+    if (mTrackFields)
+        addField(ManaServ::Int32);
+
     expand(mPos + 4);
     uint32_t t = ENET_HOST_TO_NET_32(value);
     memcpy(mData + mPos, &t, 4);
@@ -167,6 +312,57 @@ void MessageOut::writeValueType(ManaServ::ValueType type)
     mPos += 1;
 }
 
+void MessageOut::addField(ManaServ::ValueType type)
+{
+    if (mFieldCount == mFieldCapacity)
+        expandFields();
+
+    mFields[mFieldCount] = mPos << 1 | (type == ManaServ::Int32);
+    ++mFieldCount;
+}
+
+void MessageOut::expandFields()
+{
+    const unsigned capacity = mFieldCapacity * CAPACITY_GROW_FACTOR;
+    uint32_t *fields = reinterpret_cast<uint32_t*>(
+            getBufferPool().acquire(capacity * sizeof(uint32_t)));
+    memcpy(fields, mFields, mFieldCount * sizeof(uint32_t));
+    releaseFields();
+
+    mFields = fields;
+    mFieldCapacity = capacity;
+}
+
+void MessageOut::encodeCompact(std::vector<char> &data) const
+{
+    assert(mTrackFields);
+
+    // Everything between the integers is copied as is
+    unsigned pos = 0;
+    for (unsigned i = 0; i < mFieldCount; ++i)
+    {
+        const uint32_t field = mFields[i];
+        const unsigned offset = field >> 1;
+        data.insert(data.end(), mData + pos, mData + offset);
+
+        if (field & 1)
+        {
+            uint32_t t;
+            memcpy(&t, mData + offset, 4);
+            appendVarInt(data, int32_t(ENET_NET_TO_HOST_32(t)));
+            pos = offset + 4;
+        }
+        else
+        {
+            uint16_t t;
+            memcpy(&t, mData + offset, 2);
+            appendVarInt(data, int16_t(ENET_NET_TO_HOST_16(t)));
+            pos = offset + 2;
+        }
+    }
+    data.insert(data.end(), mData + pos, mData + mPos);
+}
+
 std::ostream&
 operator <<(std::ostream &os, const MessageOut &msg)
 {
@@ -187,3 +383,13 @@ void MessageOut::setDebugModeEnabled(bool enabled)
 {
     debugModeEnabled = enabled;
 }
+
+void MessageOut::setCompactEncodingEnabled(bool enabled)
+{
+    compactEncodingEnabled = enabled;
+}
+
+bool MessageOut::isCompactEncodingEnabled()
+{
+    return compactEncodingEnabled;
+}
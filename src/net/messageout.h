@@ -24,6 +24,8 @@
 #include "common/manaserv_protocol.h"
 
 #include <iosfwd>
+#include <stdint.h>
+#include <vector>
 
 /**
  * Used for building an outgoing message.
@@ -40,6 +42,15 @@ class MessageOut
 
         ~MessageOut();
 
+        MessageOut(const MessageOut &) = delete;
+        MessageOut &operator=(const MessageOut &) = delete;
+
+        /**
+         * Empties the message and starts a new one with the given ID,
+         * keeping the memory already allocated for the data.
+         */
+        void reset(int id);
+
         /**
          * Writes an 8-bit integer to the message.
          */
@@ -77,6 +88,27 @@ class MessageOut
          */
         unsigned getLength() const { return mPos; }
 
+        /**
+         * Takes the data buffer of the message, so that it can be sent
+         * without being copied, and leaves the message empty until it is
+         * reset. Returns null when the data is small enough to be in the
+         * message itself, in which case it is left as is. The buffer is
+         * given back with releaseTakenData.
+         */
+        char *takeData();
+
+        /**
+         * Gives back a buffer taken from a message of the given length.
+         */
+        static void releaseTakenData(char *data, unsigned length);
+
+        /**
+         * Appends the message to the given data in the compact encoding,
+         * with its integers written as varints. Only possible when the
+         * compact encoding is enabled.
+         */
+        void encodeCompact(std::vector<char> &data) const;
+
         /**
          * Sets whether the debug mode is enabled. In debug mode, the internal
          * data of the message is annotated so that the message contents can
@@ -86,6 +118,17 @@ class MessageOut
          */
         static void setDebugModeEnabled(bool enabled);
 
+        /**
+         * Sets whether messages keep track of their integers, so that they
+         * can be sent in the compact encoding to the clients using it. To
+         * be set once, before any message is built.
+         *
+         * The compact encoding is disabled by default.
+         */
+        static void setCompactEncodingEnabled(bool enabled);
+
+        static bool isCompactEncodingEnabled();
+
     private:
         /**
          * Ensures the capacity of the data buffer is large enough to hold the
@@ -93,12 +136,63 @@ class MessageOut
          */
         void expand(size_t size);
 
+        /**
+         * Returns the size of the data buffer a message grows to for holding
+         * the given amount of bytes.
+         */
+        static unsigned grownDataSize(size_t size);
+
         void writeValueType(ManaServ::ValueType type);
 
+        /**
+         * Remembers that an integer of the given type starts at the current
+         * position.
+         */
+        void addField(ManaServ::ValueType type);
+
+        /**
+         * Makes room for more integers to be tracked.
+         */
+        void expandFields();
+
+        /**
+         * Gives the allocated data back to the buffer pool.
+         */
+        void releaseData();
+
+        /**
+         * Gives the allocated integer positions back to the buffer pool.
+         */
+        void releaseFields();
+
+        /**
+         * Bytes stored in the message itself, which is enough for most
+         * messages. Larger ones use buffers from a pool of the thread.
+         */
+        static const unsigned INLINE_DATA_CAPACITY = 64;
+
+        /**
+         * Number of integers tracked in the message itself. A message that
+         * fits in its inline data has fewer integers than that. Larger ones
+         * track their integers in buffers from the pool as well.
+         */
+        static const unsigned INLINE_FIELDS_CAPACITY = 32;
+
         char *mData;                /**< Data building up. */
         unsigned mPos;              /**< Position in the data. */
         unsigned mDataSize;         /**< Allocated datasize. */
         bool mDebugMode;            /**< Include debugging information. */
+        char mInlineData[INLINE_DATA_CAPACITY];
+
+        /**
+         * Positions of the integers, shifted left by one bit that is set
+         * for 32-bit ones. Only kept with the compact encoding enabled.
+         */
+        bool mTrackFields;
+        unsigned mFieldCount;
+        uint32_t *mFields;
+        unsigned mFieldCapacity;
+        uint32_t mInlineFields[INLINE_FIELDS_CAPACITY];
 
         /**
          * Streams message ID and length to the given output stream.
@@ -20,23 +20,50 @@
 
 #include <iosfwd>
 #include <queue>
+#include <stdint.h>
 #include <enet/enet.h>
 
 #include "bandwidth.h"
 #include "messageout.h"
 #include "netcomputer.h"
 
+#include "../common/manaserv_protocol.h"
 #include "../utils/logger.h"
 #include "../utils/processorutils.h"
 
+/** Largest bundle, beyond which the messages are sent in another one. */
+const unsigned MAX_BUNDLE_LENGTH = 4096;
+
+/** Size of the message ID of a bundle, and of the length of its messages. */
+const unsigned BUNDLE_FIELD_LENGTH = 2;
+
+/**
+ * Appends a 16-bit integer to a bundle, in network byte order.
+ */
+static void appendInt16(std::vector<char> &bundle, unsigned value)
+{
+    const uint16_t t = ENET_HOST_TO_NET_16(value);
+    bundle.insert(bundle.end(), (const char *) &t,
+                  (const char *) &t + BUNDLE_FIELD_LENGTH);
+}
+
+/**
+ * Buffer for encoding the messages of the calling thread in the compact
+ * encoding.
+ */
+static thread_local std::vector<char> compactData;
+
 NetComputer::NetComputer(ENetPeer *peer):
-    mPeer(peer)
+    mPeer(peer),
+    mBundling(false),
+    mBundledMessages(0),
+    mCompactEncoding(false)
 {
 }
 
 bool NetComputer::isConnected() const
 {
-    return (mPeer->state == ENET_PEER_STATE_CONNECTED);
+    return mPeer && mPeer->state == ENET_PEER_STATE_CONNECTED;
 }
 
 void NetComputer::disconnect(const MessageOut &msg)
@@ -61,25 +88,208 @@ void NetComputer::send(const MessageOut &msg, bool reliable,
 {
     LOG_DEBUG("Sending message " << msg << " to " << *this);
 
-    gBandwidth->increaseClientOutput(this, msg.getLength());
+    if (mCompactEncoding)
+    {
+        compactData.clear();
+        msg.encodeCompact(compactData);
+        send(&compactData[0], compactData.size(), reliable, channel);
+    }
+    else
+    {
+        send(msg.getData(), msg.getLength(), reliable, channel);
+    }
+}
+
+void NetComputer::send(const char *data, unsigned length, bool reliable,
+                       unsigned channel)
+{
+    if (mBundling)
+    {
+        if (reliable && channel == 0 &&
+            length + 2 * BUNDLE_FIELD_LENGTH <= MAX_BUNDLE_LENGTH)
+        {
+            if (mBundle.size() + BUNDLE_FIELD_LENGTH + length >
+                    MAX_BUNDLE_LENGTH)
+                flushBundle();
+
+            if (mBundle.empty())
+                appendInt16(mBundle, ManaServ::XXMSG_BUNDLE);
+
+            appendInt16(mBundle, length);
+            mBundle.insert(mBundle.end(), data, data + length);
+            ++mBundledMessages;
+            return;
+        }
+
+        flushBundle();
+    }
+
+    sendPacket(data, length, reliable, channel);
+}
+
+void NetComputer::sendPacket(const char *data, unsigned length, bool reliable,
+                             unsigned channel)
+{
+    gBandwidth->increaseClientOutput(this, length);
+
+    // Clients without a peer are simulated, only their output is counted
+    if (!mPeer)
+        return;
 
     ENetPacket *packet;
-    packet = enet_packet_create(msg.getData(),
-                                msg.getLength(),
+    packet = enet_packet_create(data,
+                                length,
                                 reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
 
-    if (packet)
+    if (!packet)
     {
-        enet_peer_send(mPeer, channel, packet);
+        LOG_ERROR("Failure to create packet!");
+        return;
+    }
+
+    // The packet stays ours when it could not be queued
+    if (enet_peer_send(mPeer, channel, packet) < 0)
+        enet_packet_destroy(packet);
+}
+
+void NetComputer::send(const SharedPacket &packet, unsigned channel)
+{
+    flushBundle();
+
+    ENetPacket *enetPacket = packet.mPacket;
+    unsigned length = packet.mLength;
+    if (mCompactEncoding)
+    {
+        enetPacket = packet.mCompactPacket;
+        length = packet.mCompactLength;
+    }
+
+    gBandwidth->increaseClientOutput(this, length);
+
+    if (!mPeer || !enetPacket)
+        return;
+
+    enet_peer_send(mPeer, channel, enetPacket);
+}
+
+void NetComputer::setBundling(bool enabled)
+{
+    if (!enabled)
+        flushBundle();
+
+    mBundling = enabled;
+}
+
+void NetComputer::flushBundle()
+{
+    if (mBundle.empty())
+        return;
+
+    // A single message is sent as is
+    if (mBundledMessages == 1)
+    {
+        const unsigned offset = 2 * BUNDLE_FIELD_LENGTH;
+        sendPacket(&mBundle[offset], mBundle.size() - offset, true, 0);
     }
     else
     {
+        sendPacket(&mBundle[0], mBundle.size(), true, 0);
+    }
+
+    mBundle.clear();
+    mBundledMessages = 0;
+}
+
+/**
+ * Gives the data taken from a message back when ENet is done with the packet.
+ */
+static void releaseMessageData(ENetPacket *packet)
+{
+    MessageOut::releaseTakenData(reinterpret_cast<char*>(packet->data),
+                                 packet->dataLength);
+}
+
+/**
+ * Creates a packet with a reference of its own, so that the packet lives
+ * at least as long as the SharedPacket holding it, even when ENet is done
+ * sending it.
+ */
+static ENetPacket *createSharedPacket(const char *data, unsigned length,
+                                      bool reliable)
+{
+    ENetPacket *packet =
+            enet_packet_create(data, length,
+                               reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+    if (packet)
+        ++packet->referenceCount;
+    else
         LOG_ERROR("Failure to create packet!");
+
+    return packet;
+}
+
+/**
+ * Creates a shared packet around the data of the message, taken from it
+ * instead of copied when it does not fit in the message itself.
+ */
+static ENetPacket *createSharedPacket(MessageOut &msg, bool reliable)
+{
+    const unsigned length = msg.getLength();
+    char *data = msg.takeData();
+    if (!data)
+        return createSharedPacket(msg.getData(), length, reliable);
+
+    ENetPacket *packet =
+            enet_packet_create(data, length, ENET_PACKET_FLAG_NO_ALLOCATE |
+                               (reliable ? ENET_PACKET_FLAG_RELIABLE : 0));
+    if (!packet)
+    {
+        LOG_ERROR("Failure to create packet!");
+        MessageOut::releaseTakenData(data, length);
+        return nullptr;
+    }
+
+    packet->freeCallback = releaseMessageData;
+    ++packet->referenceCount;
+    return packet;
+}
+
+static void releaseSharedPacket(ENetPacket *packet)
+{
+    if (packet && --packet->referenceCount == 0)
+        enet_packet_destroy(packet);
+}
+
+SharedPacket::SharedPacket(MessageOut &msg, bool reliable):
+    mLength(msg.getLength()),
+    mCompactPacket(nullptr),
+    mCompactLength(0)
+{
+    // The compact encoding is made first, before the data is taken
+    if (MessageOut::isCompactEncodingEnabled())
+    {
+        compactData.clear();
+        msg.encodeCompact(compactData);
+        mCompactLength = compactData.size();
+        mCompactPacket = createSharedPacket(&compactData[0], mCompactLength,
+                                            reliable);
     }
+
+    mPacket = createSharedPacket(msg, reliable);
+}
+
+SharedPacket::~SharedPacket()
+{
+    releaseSharedPacket(mPacket);
+    releaseSharedPacket(mCompactPacket);
 }
 
 std::ostream &operator <<(std::ostream &os, const NetComputer &comp)
 {
+    // Simulated clients (see main-bench.cpp) have no peer
+    if (!comp.mPeer)
+        return os << "(no peer)";
+
     // address.host contains the ip-address in network-byte-order
     if (utils::processor::isLittleEndian)
         os << ( comp.mPeer->address.host & 0x000000ff)        << "."
@@ -99,5 +309,5 @@ std::ostream &operator <<(std::ostream &os, const NetComputer &comp)
 
 int NetComputer::getIP() const
 {
-    return mPeer->address.host;
+    return mPeer ? mPeer->address.host : 0;
 }
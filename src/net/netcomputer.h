@@ -22,10 +22,41 @@
 #define NETCOMPUTER_H
 
 #include <iostream>
+#include <vector>
 #include <enet/enet.h>
 
 class MessageOut;
 
+/**
+ * A message encoded once into an ENet packet, which can then be queued for
+ * sending to many computers. ENet keeps the packet until it has been sent to
+ * all of them, so a broadcast costs a single packet.
+ *
+ * The packet takes the data of larger messages instead of copying it, which
+ * leaves the message empty. Messages small enough to keep their data inline
+ * and the compact encoding are still copied.
+ */
+class SharedPacket
+{
+    public:
+        SharedPacket(MessageOut &msg, bool reliable = true);
+
+        ~SharedPacket();
+
+        SharedPacket(const SharedPacket &) = delete;
+        SharedPacket &operator=(const SharedPacket &) = delete;
+
+    private:
+        friend class NetComputer;
+
+        ENetPacket *mPacket;          /**< Null when it could not be made. */
+        unsigned mLength;
+
+        /** The message in the compact encoding, when it is enabled. */
+        ENetPacket *mCompactPacket;
+        unsigned mCompactLength;
+};
+
 /**
  * This class represents a known computer on the network. For example a
  * connected client or a server we're connected to.
@@ -71,13 +102,63 @@ class NetComputer
                   unsigned channel = 0);
 
         /**
-         * Returns IP address of computer in 32bit int form
+         * Queues the data of an already encoded message for sending to a
+         * client.
+         *
+         * @see send(const MessageOut &, bool, unsigned)
+         */
+        void send(const char *data, unsigned length, bool reliable = true,
+                  unsigned channel = 0);
+
+        /**
+         * Queues a packet shared with other computers for sending to this
+         * client.
+         *
+         * @see send(const MessageOut &, bool, unsigned)
+         */
+        void send(const SharedPacket &packet, unsigned channel = 0);
+
+        /**
+         * Sets whether the reliable messages on channel 0 are gathered into
+         * a single XXMSG_BUNDLE packet until flushBundle is called, which
+         * the client has to support. Other messages flush the bundle first,
+         * so that the order of the messages is kept.
+         */
+        void setBundling(bool enabled);
+
+        /**
+         * Sends the messages gathered since the last call, if any.
+         */
+        void flushBundle();
+
+        /**
+         * Sets whether the messages from and to this computer are in the
+         * compact encoding, which the client has to support.
+         *
+         * @see MessageOut::setCompactEncodingEnabled
+         */
+        void setCompactEncoding(bool enabled) { mCompactEncoding = enabled; }
+
+        bool usesCompactEncoding() const { return mCompactEncoding; }
+
+        /**
+         * Returns IP address of computer in 32bit int form, or 0 when the
+         * computer has no peer.
          */
         int getIP() const;
 
     private:
+        void sendPacket(const char *data, unsigned length, bool reliable,
+                        unsigned channel);
+
         ENetPeer *mPeer;              /**< Client peer */
 
+        bool mBundling;
+        std::vector<char> mBundle;    /**< Bundle message building up. */
+        unsigned mBundledMessages;    /**< Number of messages in mBundle. */
+
+        bool mCompactEncoding;
+
         /**
          * Converts the ip-address of the peer to a stringstream.
          * Example:
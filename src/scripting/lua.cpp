@@ -32,7 +32,6 @@ extern "C" {
 #include "game-server/accountconnection.h"
 #include "game-server/buysell.h"
 #include "game-server/charactercomponent.h"
-#include "game-server/collisiondetection.h"
 #include "game-server/effect.h"
 #include "game-server/gamehandler.h"
 #include "game-server/inventory.h"
@@ -293,8 +292,8 @@ static int npc_create(lua_State *s)
     beingComponent->setAttribute(*npc, maxHpAttribute, 100);
     auto *hpAttribute = attributeManager->getAttributeInfo(ATTR_HP);
     beingComponent->setAttribute(*npc, hpAttribute, 100);
-    beingComponent->setName(name);
-    beingComponent->setGender(getGender(gender));
+    beingComponent->setName(*npc, name);
+    beingComponent->setGender(*npc, getGender(gender));
 
     actorComponent->setWalkMask(Map::BLOCKMASK_WALL | Map::BLOCKMASK_MONSTER |
                                 Map::BLOCKMASK_CHARACTER);
@@ -1917,7 +1916,7 @@ static int entity_set_gender(lua_State *s)
 {
     Entity *b = checkBeing(s, 1);
     const int gender = luaL_checkinteger(s, 2);
-    b->getComponent<BeingComponent>()->setGender(getGender(gender));
+    b->getComponent<BeingComponent>()->setGender(*b, getGender(gender));
     return 0;
 }
 
@@ -2830,28 +2829,51 @@ static int get_beings_in_circle(lua_State *s)
 
     MapComposite *m = checkCurrentMap(s);
 
-    //create a lua table with the beings in the given area.
-    lua_newtable(s);
-    int tableStackPosition = lua_gettop(s);
-    int tableIndex = 1;
-    for (BeingIterator i(m->getAroundPointIterator(Point(x, y), r)); i; ++i)
+    std::vector<Entity *> beings;
+    m->getBeingsInCircle(Point(x, y), r, beings);
+    pushSTLContainer<Entity *>(s, beings);
+    return 1;
+}
+
+/** LUA get_beings_in_sector (area)
+ * get_beings_in_sector(int x, int y, int radius, int half_angle, int angle)
+ * get_beings_in_sector(handle actor, int radius, int half_angle)
+ **
+ * **Return value:** This function returns a lua table of all beings touching
+ * a circle sector of radius (in pixels) `radius` centered either at the pixel
+ * at (`x`, `y`) or at the position of `actor`. The sector spreads
+ * `half_angle` degrees to both sides of its direction. This direction is
+ * either the one `actor` is facing, or `angle` degrees with 0 being left,
+ * 90 up, 180 right and 270 down.
+ */
+static int get_beings_in_sector(lua_State *s)
+{
+    int x, y, r, halfAngle, angle;
+    if (lua_isuserdata(s, 1))
     {
-        Entity *b = *i;
-        char t = b->getType();
-        if (t == OBJECT_NPC || t == OBJECT_CHARACTER || t == OBJECT_MONSTER)
-        {
-            auto *actorComponent = b->getComponent<ActorComponent>();
-            if (Collision::circleWithCircle(actorComponent->getPosition(),
-                                            actorComponent->getSize(),
-                                            Point(x, y), r))
-            {
-                push(s, b);
-                lua_rawseti(s, tableStackPosition, tableIndex);
-                tableIndex++;
-            }
-        }
+        Entity *b = checkBeing(s, 1);
+        const Point &pos = b->getComponent<ActorComponent>()->getPosition();
+        x = pos.x;
+        y = pos.y;
+        r = luaL_checkint(s, 2);
+        halfAngle = luaL_checkint(s, 3);
+        angle = BeingComponent::directionToAngle(
+                b->getComponent<BeingComponent>()->getDirection());
     }
+    else
+    {
+        x = luaL_checkint(s, 1);
+        y = luaL_checkint(s, 2);
+        r = luaL_checkint(s, 3);
+        halfAngle = luaL_checkint(s, 4);
+        angle = luaL_checkint(s, 5);
+    }
+
+    MapComposite *m = checkCurrentMap(s);
 
+    std::vector<Entity *> beings;
+    m->getBeingsInSector(Point(x, y), r, halfAngle, angle, beings);
+    pushSTLContainer<Entity *>(s, beings);
     return 1;
 }
 
@@ -2870,25 +2892,12 @@ static int get_beings_in_rectangle(lua_State *s)
 
     MapComposite *m = checkCurrentMap(s);
 
-    //create a lua table with the beings in the given area.
-    lua_newtable(s);
-    int tableStackPosition = lua_gettop(s);
-    int tableIndex = 1;
-    Rectangle rect = {x, y ,w, h};
-    for (BeingIterator i(m->getInsideRectangleIterator(rect)); i; ++i)
-    {
-        Entity *b = *i;
-        char t = b->getType();
-        if ((t == OBJECT_NPC || t == OBJECT_CHARACTER || t == OBJECT_MONSTER) &&
-            rect.contains(b->getComponent<ActorComponent>()->getPosition()))
-        {
-            push(s, b);
-            lua_rawseti(s, tableStackPosition, tableIndex);
-            tableIndex++;
-        }
-    }
-     return 1;
- }
+    std::vector<Entity *> beings;
+    Rectangle rect = {x, y, w, h};
+    m->getBeingsInRectangle(rect, beings);
+    pushSTLContainer<Entity *>(s, beings);
+    return 1;
+}
 
 /** LUA get_distance (area)
  * get_distance(handle being1, handle being2)
@@ -3433,6 +3442,7 @@ LuaScript::LuaScript():
         { "trigger_create",                 trigger_create                    },
         { "get_beings_in_circle",           get_beings_in_circle              },
         { "get_beings_in_rectangle",        get_beings_in_rectangle           },
+        { "get_beings_in_sector",           get_beings_in_sector              },
         { "get_character_by_name",          get_character_by_name             },
         { "effect_create",                  effect_create                     },
         { "test_tableget",                  test_tableget                     },
@@ -27,6 +27,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <mutex>
 
 #ifdef WIN32
 #include <windows.h>
@@ -36,6 +37,11 @@ namespace utils
 {
 /** Log file. */
 static std::ofstream mLogFile;
+/**
+ * Serializes the output, since the maps and the paths may be updated on
+ * worker threads which log too.
+ */
+static std::mutex mOutputMutex;
 /** current log filename */
 std::string Logger::mFilename;
 /** Timestamp flag. */
@@ -140,6 +146,8 @@ void Logger::output(const std::string &msg, Level atVerbosity)
 {
     if (mVerbosity >= atVerbosity)
     {
+        std::lock_guard<std::mutex> lock(mOutputMutex);
+
         static const char *prefixes[] =
         {
         #ifdef T_COL_LOG
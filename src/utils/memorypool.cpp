@@ -0,0 +1,84 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/memorypool.h"
+
+#include <new>
+
+namespace utils
+{
+
+MemoryPool::MemoryPool(std::size_t objectSize, unsigned objectsPerBlock):
+    mObjectsPerBlock(objectsPerBlock),
+    mFreeObjects(nullptr)
+{
+    // Keep every object suitably aligned for any type.
+    const std::size_t alignment = alignof(std::max_align_t);
+    if (objectSize < sizeof(FreeObject))
+        objectSize = sizeof(FreeObject);
+    mObjectSize = (objectSize + alignment - 1) / alignment * alignment;
+}
+
+MemoryPool::~MemoryPool()
+{
+    for (std::vector<char *>::iterator it = mBlocks.begin(),
+         it_end = mBlocks.end(); it != it_end; ++it)
+    {
+        ::operator delete(*it);
+    }
+}
+
+void *MemoryPool::allocate()
+{
+    if (!mFreeObjects)
+        allocateBlock();
+
+    FreeObject *object = mFreeObjects;
+    mFreeObjects = object->next;
+    return object;
+}
+
+void MemoryPool::deallocate(void *object)
+{
+    if (!object)
+        return;
+
+    FreeObject *freeObject = static_cast<FreeObject *>(object);
+    freeObject->next = mFreeObjects;
+    mFreeObjects = freeObject;
+}
+
+void MemoryPool::allocateBlock()
+{
+    char *block = static_cast<char *>(
+            ::operator new(mObjectSize * mObjectsPerBlock));
+    mBlocks.push_back(block);
+
+    // Chain the objects so that they are handed out in address order.
+    for (unsigned i = mObjectsPerBlock; i-- > 0;)
+    {
+        FreeObject *object =
+                reinterpret_cast<FreeObject *>(block + i * mObjectSize);
+        object->next = mFreeObjects;
+        mFreeObjects = object;
+    }
+}
+
+} // namespace utils
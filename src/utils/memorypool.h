@@ -0,0 +1,67 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMORYPOOL_H
+#define MEMORYPOOL_H
+
+#include <cstddef>
+#include <vector>
+
+namespace utils
+{
+
+/**
+ * Hands out memory for objects of a fixed size, taken from large blocks so
+ * that the objects stay close to each other. Freed objects are reused before
+ * allocating a new block, and blocks are only released with the pool.
+ *
+ * Not thread safe.
+ */
+class MemoryPool
+{
+    public:
+        MemoryPool(std::size_t objectSize, unsigned objectsPerBlock = 256);
+
+        ~MemoryPool();
+
+        void *allocate();
+
+        void deallocate(void *object);
+
+    private:
+        MemoryPool(const MemoryPool &);
+        MemoryPool &operator=(const MemoryPool &);
+
+        struct FreeObject
+        {
+            FreeObject *next;
+        };
+
+        void allocateBlock();
+
+        std::size_t mObjectSize;
+        unsigned mObjectsPerBlock;
+        FreeObject *mFreeObjects;
+        std::vector<char *> mBlocks;
+};
+
+} // namespace utils
+
+#endif // MEMORYPOOL_H
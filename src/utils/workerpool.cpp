@@ -0,0 +1,89 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/workerpool.h"
+
+namespace utils
+{
+
+WorkerPool::WorkerPool(unsigned threads):
+    mRunningJobs(0),
+    mQuit(false)
+{
+    for (unsigned i = 0; i < threads; ++i)
+        mThreads.push_back(std::thread(&WorkerPool::run, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mJobAdded.notify_all();
+
+    for (std::thread &thread : mThreads)
+        thread.join();
+}
+
+void WorkerPool::enqueue(const Job &job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.push_back(job);
+    }
+    mJobAdded.notify_one();
+}
+
+void WorkerPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mJobs.empty() || mRunningJobs > 0)
+        mJobsDone.wait(lock);
+}
+
+void WorkerPool::run()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;)
+    {
+        while (mJobs.empty() && !mQuit)
+            mJobAdded.wait(lock);
+
+        if (mJobs.empty())
+            return; // Quitting
+
+        Job job = mJobs.front();
+        mJobs.pop_front();
+        ++mRunningJobs;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        --mRunningJobs;
+        if (mJobs.empty() && mRunningJobs == 0)
+            mJobsDone.notify_all();
+    }
+}
+
+} // namespace utils
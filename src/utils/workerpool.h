@@ -0,0 +1,92 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2013  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+
+/**
+ * A fixed set of threads running jobs, used to spread work that does not need
+ * to happen on the main thread over several cores.
+ */
+class WorkerPool
+{
+    public:
+        typedef std::function<void ()> Job;
+
+        /**
+         * Constructor.
+         *
+         * @param threads the number of worker threads to start
+         */
+        WorkerPool(unsigned threads);
+
+        /**
+         * Waits for the enqueued jobs and stops the worker threads.
+         */
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        /**
+         * Adds a job to be run by one of the worker threads.
+         */
+        void enqueue(const Job &job);
+
+        /**
+         * Blocks until all the enqueued jobs have been run.
+         */
+        void wait();
+
+        /**
+         * Gets the number of worker threads.
+         */
+        unsigned getThreadCount() const
+        { return mThreads.size(); }
+
+    private:
+        /**
+         * Runs jobs until the pool is destroyed.
+         */
+        void run();
+
+        std::vector<std::thread> mThreads;
+        std::deque<Job> mJobs;      /**< Jobs waiting for a thread. */
+        unsigned mRunningJobs;      /**< Jobs currently being run. */
+        bool mQuit;
+
+        std::mutex mMutex;
+        std::condition_variable mJobAdded;
+        std::condition_variable mJobsDone;
+};
+
+} // namespace utils
+
+#endif // WORKERPOOL_H